@@ -0,0 +1,337 @@
+// A fixed benchmark suite printing its results as JSON, so that runs
+// can be diffed and gated on regressions. Every case is timed over
+// several repetitions (after one warm up run) and reports the median,
+// the 10th/90th percentiles and, where the search effort is known,
+// the number of search nodes per second. Random instances are seeded,
+// so that all the runs of the suite solve identical instances.
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dlx.h"
+#include "examples/nqueens.h"
+#include "examples/sudoku.h"
+
+namespace {
+
+constexpr int kRepetitions = 7;
+
+struct Result {
+  std::string name;
+  std::vector<double> seconds; // Sorted.
+  long nodes;                  // Search nodes per run, or -1 if unknown.
+};
+
+std::vector<Result> results;
+
+double Percentile(const std::vector<double> &sorted, double p) {
+  return sorted[std::min<int>(sorted.size() - 1, p * sorted.size())];
+}
+
+// Times `run` and records the result under `name`.
+template <class Run> void Measure(const std::string &name, long nodes, Run run) {
+  run();
+  Result result{name, {}, nodes};
+  for (int rep = 0; rep < kRepetitions; rep++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    result.seconds.push_back(std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count());
+  }
+  std::sort(result.seconds.begin(), result.seconds.end());
+  std::cerr << name << ": " << Percentile(result.seconds, 0.5) << "s\n";
+  results.push_back(result);
+}
+
+std::vector<std::string> ReadLines(const std::string &filename) {
+  std::vector<std::string> lines;
+  std::ifstream input(filename);
+  for (std::string line; std::getline(input, line);)
+    lines.push_back(line);
+  return lines;
+}
+
+const char *MethodName(dlx::SolutionMethod method) {
+  return method == dlx::SolutionMethod::RECURSIVE ? "rsolve" : "isolve";
+}
+
+// The 91 puzzles, each solved and checked for uniqueness.
+template <class ColumnPickingPolicy, class Index,
+          template <class, class, class> class Engine = dlx::DancingLinks>
+void BenchmarkSudoku(const std::vector<std::string> &puzzles,
+                     const std::string &name, dlx::SolutionMethod method) {
+  Sudoku<ColumnPickingPolicy, Index, dlx::SearchStats, Engine> counter{3};
+  long nodes = 0;
+  for (const auto &puzzle : puzzles) {
+    if (counter.SetProblem(puzzle)) {
+      counter.MoreThanOneSolution(method);
+      nodes += counter.Stats().nodes;
+    }
+  }
+  Sudoku<ColumnPickingPolicy, Index, dlx::NoStats, Engine> sudoku{3};
+  Measure(name + "/" + MethodName(method), nodes, [&]() {
+    for (const auto &puzzle : puzzles) {
+      if (sudoku.SetProblem(puzzle) && sudoku.MoreThanOneSolution(method))
+        std::abort();
+    }
+  });
+}
+
+// The same uniqueness tests on copies of a prebuilt arena, with the
+// clues selected and, if `reduce`, Reduce()d before the search.
+void BenchmarkSudokuReduce(const std::vector<std::string> &puzzles,
+                           bool reduce, dlx::Propagation propagation) {
+  SudokuMatrix matrix{3};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> base{
+      matrix};
+  base.SetPropagation(propagation);
+  auto solve = [&](const std::string &puzzle, long *nodes) {
+    if (puzzle.size() < 81) // As rejected by Sudoku::SetProblem(..).
+      return;
+    auto dlx = base;
+    for (int k = 0; k < 81; k++) {
+      if (puzzle[k] != '.' && puzzle[k] != '0' &&
+          !dlx.SelectRow(k % 9 * 81 + k / 9 * 9 + puzzle[k] - '1'))
+        std::abort();
+    }
+    if (reduce)
+      dlx.Reduce();
+    dlx::UniquenessTestingVisitor visitor;
+    dlx.Solve(visitor);
+    if (visitor.MoreThanOneSolution())
+      std::abort();
+    *nodes += dlx.Stats().nodes;
+  };
+  long nodes = 0;
+  for (const auto &puzzle : puzzles)
+    solve(puzzle, &nodes);
+  const bool propagate = propagation == dlx::Propagation::SINGLETONS;
+  Measure(std::string("sudoku91/") + (reduce ? "reduce" : "select") +
+              (propagate ? "+propagate" : "") + "/isolve",
+          nodes, [&]() {
+            long ignored = 0;
+            for (const auto &puzzle : puzzles)
+              solve(puzzle, &ignored);
+          });
+}
+
+template <class ColumnPickingPolicy,
+          template <class, class, class> class Engine = dlx::DancingLinks>
+void BenchmarkNQueens(const std::string &policy, int n,
+                      dlx::SolutionMethod method) {
+  NQueensMatrix matrix{n};
+  Engine<ColumnPickingPolicy, int, dlx::SearchStats> counter{matrix};
+  counter.Solve(dlx::CountingVisitor<long>{}, method);
+  Engine<ColumnPickingPolicy, int, dlx::NoStats> dlx{matrix};
+  Measure("nqueens/" + policy + "/n=" + std::to_string(n) + "/" +
+              MethodName(method),
+          counter.Stats().nodes, [&]() {
+            dlx::CountingVisitor<long> visitor;
+            dlx.Solve(visitor, method);
+          });
+}
+
+// First solutions from 30 seeds with randomized restarts. (Single
+// randomized descents take up to tens of seconds on some seeds.)
+void BenchmarkRestarts(int n, dlx::RestartSchedule schedule,
+                       const std::string &name) {
+  NQueensMatrix matrix{n};
+  dlx::DancingLinks<dlx::UniformlyRandomColumn> dlx{matrix};
+  Measure("restarts/nqueens/n=" + std::to_string(n) + "/" + name, -1, [&]() {
+    for (uint32_t seed = 0; seed < 30; seed++) {
+      dlx.Seed(seed);
+      if (!dlx.RestartSolve(dlx::CountingVisitor<int>{}, 200, schedule))
+        std::abort();
+    }
+  });
+}
+
+// Writing out the 14200 solutions of 12 queens to /dev/null: through
+// an std::ostream one number at a time as DefaultVisitor used to, and
+// through an OutputBuffer in the text and the binary format.
+void BenchmarkOutput() {
+  NQueensMatrix matrix{12};
+  dlx::DancingLinks<> dlx{matrix};
+  std::vector<std::vector<int>> solns;
+  dlx.Solve(dlx::SavingVisitor{&solns});
+  std::ofstream null_stream("/dev/null");
+  Measure("output/nqueens12/ostream", -1, [&]() {
+    for (const auto &soln : solns) {
+      null_stream << "[";
+      for (size_t i = 0; i < soln.size(); i++)
+        null_stream << soln[i] << (i != soln.size() - 1 ? ", " : "");
+      null_stream << "]";
+    }
+    null_stream.flush();
+  });
+  int fd = open("/dev/null", O_WRONLY);
+  Measure("output/nqueens12/text", -1, [&]() {
+    dlx::OutputBuffer out{fd};
+    for (const auto &soln : solns)
+      dlx::PutText(soln, &out);
+  });
+  Measure("output/nqueens12/binary", -1, [&]() {
+    dlx::OutputBuffer out{fd};
+    for (const auto &soln : solns)
+      dlx::PutBinary(soln, &out);
+  });
+  close(fd);
+}
+
+// Random instance with `cols` primary columns and `rows` rows, each
+// column in each row with probability `density`. The rows of a
+// random partition of the columns are planted to ensure a solution.
+dlx::SparseMatrixFromVector RandomInstance(int rows, int cols, double density,
+                                           unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  std::vector<std::vector<int>> matrix;
+  std::vector<int> perm(cols);
+  for (int j = 0; j < cols; j++)
+    perm[j] = j;
+  std::shuffle(perm.begin(), perm.end(), gen);
+  for (int start = 0, size = 1; start < cols; start += size) {
+    size = std::min<int>(cols - start, 1 + density * cols);
+    matrix.emplace_back(perm.begin() + start, perm.begin() + start + size);
+    std::sort(matrix.back().begin(), matrix.back().end());
+  }
+  while (matrix.size() < size_t(rows)) {
+    std::vector<int> row;
+    for (int j = 0; j < cols; j++)
+      if (uniform(gen) < density)
+        row.push_back(j);
+    if (!row.empty())
+      matrix.push_back(row);
+  }
+  std::shuffle(matrix.begin(), matrix.end(), gen);
+  return dlx::SparseMatrixFromVector(matrix, cols, cols);
+}
+
+template <template <class, class, class> class Engine = dlx::DancingLinks>
+void BenchmarkRandom(const std::string &prefix, double density) {
+  auto matrix = RandomInstance(400, 60, density, 2017);
+  Engine<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> counter{matrix};
+  counter.Solve(dlx::CountingVisitor<long>{});
+  Engine<dlx::ColumnWithLeastOnes, int, dlx::NoStats> dlx{matrix};
+  Measure(prefix + "/400x60/density=" + std::to_string(density).substr(0, 4),
+          counter.Stats().nodes, [&]() {
+            dlx::CountingVisitor<long> visitor;
+            dlx.Solve(visitor);
+          });
+}
+
+void PrintJson() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::cout << "{\n  \"repetitions\": " << kRepetitions
+            << ",\n  \"peak_rss_kb\": " << usage.ru_maxrss
+            << ",\n  \"benchmarks\": [\n";
+  for (size_t k = 0; k < results.size(); k++) {
+    const auto &r = results[k];
+    double median = Percentile(r.seconds, 0.5);
+    std::cout << "    {\"name\": \"" << r.name << "\", \"median_s\": " << median
+              << ", \"p10_s\": " << Percentile(r.seconds, 0.1)
+              << ", \"p90_s\": " << Percentile(r.seconds, 0.9)
+              << ", \"nodes\": " << r.nodes << ", \"nodes_per_s\": "
+              << (r.nodes >= 0 && median > 0 ? r.nodes / median : -1) << "}"
+              << (k + 1 < results.size() ? ",\n" : "\n");
+  }
+  std::cout << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::vector<std::string> puzzles{ReadLines("data/sudoku.in.txt")};
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    BenchmarkSudoku<dlx::ColumnWithLeastOnes, int>(puzzles, "sudoku91", method);
+  }
+  BenchmarkSudoku<dlx::BucketedColumnWithLeastOnes, int>(
+      puzzles, "sudoku91/bucketed", dlx::SolutionMethod::ITERATIVE);
+  BenchmarkSudoku<dlx::ColumnWithLeastOnes, int16_t>(
+      puzzles, "sudoku91/int16", dlx::SolutionMethod::ITERATIVE);
+  BenchmarkSudoku<dlx::ColumnWithLeastOnes, int64_t>(
+      puzzles, "sudoku91/int64", dlx::SolutionMethod::ITERATIVE);
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    BenchmarkSudoku<dlx::ColumnWithLeastOnes, int, dlx::DancingCells>(
+        puzzles, "sudoku91/cells", method);
+    BenchmarkSudoku<dlx::ColumnWithLeastOnes, int, dlx::BitsetEngine>(
+        puzzles, "sudoku91/bitset", method);
+  }
+
+  BenchmarkSudokuReduce(puzzles, false, dlx::Propagation::NONE);
+  BenchmarkSudokuReduce(puzzles, true, dlx::Propagation::NONE);
+  BenchmarkSudokuReduce(puzzles, false, dlx::Propagation::SINGLETONS);
+  BenchmarkSudokuReduce(puzzles, true, dlx::Propagation::SINGLETONS);
+
+  // Minimal puzzles, probed on one live solver.
+  for (int n : {2, 3}) {
+    SudokuGenerator generator{n, 1};
+    Measure("sudoku_generator/n=" + std::to_string(n) + "/10", -1, [&]() {
+      for (int k = 0; k < 10; k++)
+        generator.Next();
+    });
+  }
+
+  // Building the arena only.
+  for (int n : {3, 4, 5}) {
+    SudokuMatrix matrix{n};
+    dlx::DancingLinks<> dlx;
+    Measure("initialize/sudoku/n=" + std::to_string(n), -1,
+            [&]() { dlx.Initialize(matrix); });
+  }
+
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    for (int n = 6; n <= 10; n++) {
+      BenchmarkNQueens<dlx::FirstAvailableColumn>("first", n, method);
+      BenchmarkNQueens<dlx::LastAvailableColumn>("last", n, method);
+      BenchmarkNQueens<dlx::UniformlyRandomColumn>("random", n, method);
+      BenchmarkNQueens<dlx::ColumnWithLeastOnes>("least_ones", n, method);
+      BenchmarkNQueens<dlx::BucketedColumnWithLeastOnes>("bucketed", n,
+                                                         method);
+      BenchmarkNQueens<dlx::ColumnWithLeastOnes, dlx::DancingCells>(
+          "cells/least_ones", n, method);
+      BenchmarkNQueens<dlx::ColumnWithLeastOnes, dlx::BitsetEngine>(
+          "bitset/least_ones", n, method);
+    }
+  }
+
+  // Counting all the solutions, or one per class under the symmetries
+  // of the board.
+  for (int n : {10, 12}) {
+    NQueens<dlx::ColumnWithLeastOnes> nqueens{n};
+    Measure("nqueens/count/n=" + std::to_string(n), -1,
+            [&]() { nqueens.Count(); });
+    Measure("nqueens/symmetric/n=" + std::to_string(n), -1,
+            [&]() { nqueens.SymmetricCount(); });
+  }
+
+  BenchmarkRestarts(50, dlx::RestartSchedule::LUBY, "luby");
+  BenchmarkRestarts(50, dlx::RestartSchedule::GEOMETRIC, "geometric");
+
+  BenchmarkOutput();
+
+  for (double density : {0.1, 0.15, 0.2}) {
+    BenchmarkRandom("random", density);
+    BenchmarkRandom<dlx::DancingCells>("random/cells", density);
+    BenchmarkRandom<dlx::BitsetEngine>("random/bitset", density);
+  }
+
+  PrintJson();
+  return 0;
+}
@@ -21,20 +21,111 @@
 //   it suffices to specify the (zero-based) column index of the first
 //   secondary column to infer the set of secondary columns.
 //
+// - The 1s in secondary columns may be colored (Knuth's Algorithm C):
+//   rows agreeing on the color of a secondary column may share it,
+//   which replaces large auxiliary column sets in many encodings.
+//   Instances without colors pay nothing for the feature.
+//
+// - Primary columns may also be covered between lo and hi times
+//   (Knuth's Algorithm M) instead of once, which avoids expanding them
+//   into many symmetric copies. Such instances are solved by a search
+//   that never visits the same set of rows twice, and the default
+//   policy then picks the column with the least slack.
+//
 // - The input instance (0/1 Matrix along with the index of the first
 //   secondary column) is injected through a *MatrixInterface* object.
+//   Sparse instances should implement *SparseMatrixInterface* instead,
+//   which lists the 1s of each row so that initialization runs in
+//   time proportional to the number of 1s rather than rows x columns.
 //
 // - By specifying different *VisitorInterface* objects to the
 //   solution methods (RSolve/ISolve), it is possible to print some/all
 //   of the solutions, gather statistics on the solutions, etc.
+//   Solutions() instead returns an iterator that resumes the search
+//   for one solution per Next(), for callers that pull solutions.
+//   The position of such a search can be saved as a *Checkpoint* and
+//   resumed by another process, and CheckpointedSolve(..) does so
+//   periodically for long enumerations.
+//
+// - *TextInstance* reads instances in the text format of Knuth's DLX
+//   programs, and SaveArena(..) writes the arena of an instance to a
+//   file that LoadArena(..) maps into memory and solves in place, with
+//   no parsing or initialization (see examples/dlx_solve.cc).
+//
+// - Reduce(..) simplifies an instance before the search, selecting
+//   the rows forced by columns with a single row and dropping the rows
+//   that cannot be in any solution, and rebuilds a smaller arena.
+//
+// - SetPropagation(..) has the search commit the rows of columns left
+//   with a single row as it goes, without branching nodes for them.
+//
+// - AddSymmetry(..) declares symmetries of an instance, and
+//   SymmetricSolve(..) visits one solution per class under them and
+//   counts all the others (see NQueens::SymmetricCount()).
+//
+// - Cube(..) splits a search into jobs that Conquer(..) solves
+//   independently, in other processes or on other machines, and whose
+//   outputs MergeJobResults(..) combines (see examples/dlx_merge.cc).
+//
+// - ParallelSolve(..) splits the search among several threads, each
+//   working on a private copy of the instance and reporting through
+//   its own visitor (or a shared *SynchronizedVisitor*).
+//
+// - *BatchSolver* solves streams of independent instances (e.g. sets
+//   of rows to select on a shared base matrix) on a pool of threads,
+//   each owning its own solver.
+//
+// - ZddSolve(..) memoizes identical subproblems and returns all the
+//   solutions as a zero-suppressed decision diagram (*Zdd*) that can be
+//   counted, enumerated or sampled without searching again.
+//
+// - The *Index* template parameter sets the width of the arena
+//   indices (int by default; int16_t for small instances, int64_t for
+//   instances with more than 2^31 cells), and CellOrder::COLUMN_MAJOR
+//   numbers the cells of each column consecutively.
+//
+// - *DancingCells* is a second engine with the same interface, built on
+//   sparse sets (Knuth's "dancing cells") instead of linked lists, so
+//   that covering scans contiguous memory. It solves exact cover
+//   instances with the same visitors and policies, and is picked at
+//   compile time by naming it instead of DancingLinks.
+//
+// - *TextSolutionWriter* and *BinarySolutionWriter* write solutions
+//   through an *OutputBuffer* that hands large blocks to a file
+//   descriptor, in a line per solution or in compact varints.
+//
+// - *BitsetEngine* is a third engine, for small exact cover instances
+//   (up to a few thousand columns): columns are bitsets of rows, and
+//   choosing a row takes a few word operations per column of it, with
+//   nothing to undo. *AdaptiveSolver* picks BitsetEngine
+//   or DancingLinks by the size and the kind of each instance.
+//
+// - The policy class *StatsPolicy* optionally gathers search
+//   statistics (nodes, link updates, per-depth profile, time to the
+//   first solution) at no cost when left to the default NoStats.
 //
 // - The policy class *ColumnPickingPolicy* allows different column
 //   picking heuristics to be baked in at compile time. The default
 //   policy works well (fast), but you may pick another policy like
 //   FirstAvailableColumn if you are interested in a specific ordering
-//   of the solutions.
+//   of the solutions. BucketedColumnWithLeastOnes picks the same
+//   columns as the default without scanning them, which pays off on
+//   instances with many primary columns. UniformlyRandomColumn draws from
+//   a seeded generator owned by the solver (see Seed(..)), and
+//   RestartSolve(..) uses it to look for a first solution through
+//   restarts with growing node budgets (Luby or geometric).
 
+#include "include/arena.h"
+#include "include/batch.h"
+#include "include/bitset_engine.h"
+#include "include/checkpoint.h"
+#include "include/cube.h"
+#include "include/dancing_cells.h"
 #include "include/dlx_internal.h"
 #include "include/matrix.h"
+#include "include/output.h"
 #include "include/policies.h"
+#include "include/stats.h"
+#include "include/text_format.h"
 #include "include/visitor.h"
+#include "include/zdd.h"
@@ -0,0 +1,39 @@
+// Merges the outputs of the jobs a search was split into by dlx_solve
+// (see examples/dlx_solve.cc) into the output of the whole search:
+//
+//   dlx_solve --cube-jobs=64 --jobs-dir=jobs FILE
+//   for job in jobs/job-*.txt; do
+//     dlx_solve --job=$job --mode=count FILE > $job.out
+//   done
+//   dlx_merge --mode=count jobs/*.out
+//
+// Fails if the output of any job is missing or repeated.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dlx.h"
+
+int main(int argc, char **argv) {
+  std::ios_base::sync_with_stdio(false);
+  std::string mode = "count";
+  std::vector<std::string> paths;
+  for (int k = 1; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg.rfind("--mode=", 0) == 0)
+      mode = arg.substr(7);
+    else
+      paths.push_back(arg);
+  }
+  if (paths.empty() || (mode != "count" && mode != "all")) {
+    std::cerr << "Usage: dlx_merge [--mode=count|all] OUTPUT...\n";
+    return 2;
+  }
+  std::string error;
+  if (!dlx::MergeJobResults(paths, mode == "count", std::cout, &error)) {
+    std::cerr << error << "\n";
+    return 2;
+  }
+  return 0;
+}
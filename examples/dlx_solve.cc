@@ -0,0 +1,203 @@
+// Solves an exact cover instance read from a file, either in the text
+// format of Knuth's DLX programs (see dlx::TextInstance) or as an arena
+// written by --save-arena, which is mapped into memory and solved in
+// place.
+//
+//   dlx_solve [--mode=count|first|all|unique] [--save-arena=PATH] FILE
+//   dlx_solve --cube-depth=D|--cube-jobs=N [--jobs-dir=DIR] FILE
+//   dlx_solve --job=JOB [--mode=count|all] FILE
+//
+// Solutions are printed one per line as the (zero-based) indices of
+// their rows, which for text instances are the options in input order.
+// The exit status is 1 if --mode=first or unique finds no solution.
+//
+// To spread a search over several processes or machines, --cube-depth
+// or --cube-jobs splits it into jobs written to DIR/job-K.txt (see
+// dlx::DancingLinks::Cube(..)), --job solves one of them on the same
+// FILE, and dlx_merge combines the outputs of all of them into that of
+// the whole search.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "dlx.h"
+
+namespace {
+
+struct Options {
+  std::string mode = "count", save_path, jobs_dir = ".", job_path;
+  int cube_depth = -1, cube_jobs = 0;
+};
+
+int Usage() {
+  std::cerr << "Usage: dlx_solve [--mode=count|first|all|unique] "
+               "[--save-arena=PATH] FILE\n"
+               "       dlx_solve --cube-depth=D|--cube-jobs=N "
+               "[--jobs-dir=DIR] FILE\n"
+               "       dlx_solve --job=JOB [--mode=count|all] FILE\n";
+  return 2;
+}
+
+// Reads the header of `path` if it is an arena file.
+bool ReadArenaHeader(const std::string &path, dlx::ArenaFileHeader *header) {
+  std::ifstream in(path, std::ios::binary);
+  return in.read(reinterpret_cast<char *>(header), sizeof(*header)) &&
+         std::memcmp(header->magic, dlx::ArenaFileHeader::kMagic,
+                     sizeof(header->magic)) == 0;
+}
+
+template <class Index>
+int Solve(dlx::DancingLinks<dlx::ColumnWithLeastOnes, Index> &dlx,
+          const std::string &mode) {
+  if (mode == "count") {
+    dlx::CountingVisitor<unsigned long> visitor;
+    dlx.Solve(visitor);
+    std::cout << visitor.Count() << "\n";
+    return 0;
+  }
+  dlx::OutputBuffer out{1};
+  if (mode == "all") {
+    dlx.Solve(dlx::TextSolutionWriter{&out});
+    return 0;
+  }
+  // Look for up to two solutions, and print the first.
+  const int limit = (mode == "unique" ? 2 : 1);
+  int found = 0;
+  dlx.Solve([&](const std::vector<int> &solution) {
+    if (found++ == 0)
+      dlx::PutText(solution, &out);
+    return found < limit;
+  });
+  if (mode == "unique") {
+    const char *verdict[] = {"none\n", "unique\n", "multiple\n"};
+    out.Put(verdict[found], std::strlen(verdict[found]));
+  }
+  return found > 0 ? 0 : 1;
+}
+
+// Writes the jobs of a split to `dir`.
+template <class Index>
+int Cube(dlx::DancingLinks<dlx::ColumnWithLeastOnes, Index> &dlx,
+         const Options &options) {
+  const std::vector<dlx::CubeJob> jobs =
+      options.cube_depth >= 0 ? dlx.Cube(options.cube_depth)
+                              : dlx.CubeJobs(options.cube_jobs);
+  for (const auto &job : jobs) {
+    const std::string path =
+        options.jobs_dir + "/job-" + std::to_string(job.index) + ".txt";
+    if (!job.Write(path)) {
+      std::cerr << path << ": write failed\n";
+      return 2;
+    }
+  }
+  std::cout << jobs.size() << " jobs\n";
+  return 0;
+}
+
+// Solves one job, after a header for dlx_merge.
+template <class Index>
+int Conquer(dlx::DancingLinks<dlx::ColumnWithLeastOnes, Index> &dlx,
+            const Options &options) {
+  dlx::CubeJob job;
+  if (!job.Read(options.job_path)) {
+    std::cerr << options.job_path << ": not a job file\n";
+    return 2;
+  }
+  const std::string header = dlx::JobResultHeader(job);
+  bool conquered;
+  if (options.mode == "count") {
+    dlx::CountingVisitor<unsigned long> visitor;
+    conquered = dlx.Conquer(job, visitor);
+    std::cout << header << visitor.Count() << "\n";
+  } else {
+    dlx::OutputBuffer out{1};
+    out.Put(header.data(), header.size());
+    conquered = dlx.Conquer(job, dlx::TextSolutionWriter{&out});
+  }
+  if (!conquered) {
+    std::cerr << options.job_path << ": not a job of this instance\n";
+    return 2;
+  }
+  return 0;
+}
+
+template <class Index>
+int Run(const std::string &path, dlx::TextInstance *text,
+        const Options &options) {
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, Index> dlx;
+  if (text != nullptr) {
+    dlx.Initialize(text->Matrix());
+  } else if (!dlx.LoadArena(path)) {
+    std::cerr << path << ": not an arena file for this machine\n";
+    return 2;
+  }
+  if (!options.save_path.empty()) {
+    if (!dlx.SaveArena(options.save_path)) {
+      std::cerr << options.save_path << ": write failed\n";
+      return 2;
+    }
+    return 0;
+  }
+  if (options.cube_depth >= 0 || options.cube_jobs > 0)
+    return Cube(dlx, options);
+  if (!options.job_path.empty())
+    return Conquer(dlx, options);
+  return Solve(dlx, options.mode);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::ios_base::sync_with_stdio(false);
+  Options options;
+  std::string path;
+  for (int k = 1; k < argc; k++) {
+    const std::string arg = argv[k];
+    if (arg.rfind("--mode=", 0) == 0)
+      options.mode = arg.substr(7);
+    else if (arg.rfind("--save-arena=", 0) == 0)
+      options.save_path = arg.substr(13);
+    else if (arg.rfind("--cube-depth=", 0) == 0)
+      options.cube_depth = std::atoi(arg.c_str() + 13);
+    else if (arg.rfind("--cube-jobs=", 0) == 0)
+      options.cube_jobs = std::atoi(arg.c_str() + 12);
+    else if (arg.rfind("--jobs-dir=", 0) == 0)
+      options.jobs_dir = arg.substr(11);
+    else if (arg.rfind("--job=", 0) == 0)
+      options.job_path = arg.substr(6);
+    else if (path.empty() && arg.rfind("--", 0) != 0)
+      path = arg;
+    else
+      return Usage();
+  }
+  const std::string &mode = options.mode;
+  if (path.empty() || (mode != "count" && mode != "first" && mode != "all" &&
+                       mode != "unique"))
+    return Usage();
+  if (!options.job_path.empty() && mode != "count" && mode != "all")
+    return Usage(); // Only these merge.
+
+  dlx::ArenaFileHeader header;
+  if (ReadArenaHeader(path, &header)) {
+    return header.index_size == sizeof(int64_t)
+               ? Run<int64_t>(path, nullptr, options)
+               : Run<int>(path, nullptr, options);
+  }
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << path << ": cannot open\n";
+    return 2;
+  }
+  dlx::TextInstance text;
+  std::string error;
+  if (!text.Read(in, &error)) {
+    std::cerr << path << ": " << error << "\n";
+    return 2;
+  }
+  return Run<int>(path, &text, options);
+}
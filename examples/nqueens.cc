@@ -1,12 +1,47 @@
 #include "examples/nqueens.h"
 
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char **argv) {
   std::ios_base::sync_with_stdio(false);
   int n = (argc > 1) ? atoi(argv[1]) : 8;
+  if (argc > 3 && std::strcmp(argv[2], "--checkpoint") == 0) {
+    // Count all the solutions, resuming from and saving progress to the
+    // given file every 10 seconds.
+    NQueens<dlx::ColumnWithLeastOnes> nqueens{n};
+    std::cout << nqueens.CheckpointedCount(argv[3], 10) << " solutions.\n";
+    return 0;
+  }
+  if (argc > 2 && std::strcmp(argv[2], "--symmetric") == 0) {
+    // Count all the solutions both ways, and compare.
+    NQueens<dlx::ColumnWithLeastOnes> nqueens{n};
+    auto start = std::chrono::steady_clock::now();
+    unsigned long count = nqueens.Count();
+    auto middle = std::chrono::steady_clock::now();
+    unsigned long symmetric = nqueens.SymmetricCount();
+    std::chrono::duration<double> plain = middle - start,
+                                  reduced = std::chrono::steady_clock::now() -
+                                            middle;
+    std::cout << count << " solutions in " << plain.count() << "s, "
+              << symmetric << " through symmetry classes in "
+              << reduced.count() << "s.\n";
+    return count == symmetric ? 0 : 1;
+  }
   int k = (argc > 2) ? atoi(argv[2]) : 1;
+  int threads = (argc > 3) ? atoi(argv[3]) : 0;
+  if (threads > 0) { // Count all the solutions on the given number of threads.
+    NQueens<dlx::ColumnWithLeastOnes> nqueens{n};
+    auto start = std::chrono::steady_clock::now();
+    unsigned int count = nqueens.ParallelCount(threads);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << count << " solutions in " << elapsed.count() << "s on "
+              << threads << " threads.\n";
+    return 0;
+  }
   NQueens<dlx::UniformlyRandomColumn> nqueens{n};
   NQueensVisitor visitor{n, k}; // Only print the first k solutions.
   nqueens.Solve(visitor, dlx::SolutionMethod::ITERATIVE);
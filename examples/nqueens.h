@@ -1,12 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "dlx.h"
 
-class NQueensMatrix : public dlx::MatrixInterface {
+class NQueensMatrix : public dlx::SparseMatrixInterface {
 public:
   NQueensMatrix(int q = 4) : n_(q) {}
   void SetN(int q) { n_ = q; }
@@ -16,14 +18,42 @@ public:
   int Value(int i, int j) override {
     int x = i / n_, y = i % n_;
     return (j == x || j == n_ + y || j == 2 * n_ + x + y ||
-            j == 4 * n_ - 1 + y - x + n_);
+            j == 5 * n_ - 2 + y - x);
+  }
+  // Each row places a queen and so hits exactly four columns.
+  int NonZeros() override { return 4 * n_ * n_; }
+  void Row(int i, std::vector<int> *cols) override {
+    int x = i / n_, y = i % n_;
+    *cols = {x, n_ + y, 2 * n_ + x + y, 5 * n_ - 2 + y - x};
   }
   int FirstSecondaryColumnIndex() override { return 2 * n_; }
 
+  // The symmetry of the board moving the queen at (x, y) to
+  // (y, n-1-x) if `rotate`, else to (x, n-1-y), as permutations of the
+  // rows and of the columns (see dlx::DancingLinks::AddSymmetry(..)).
+  // The two generate the 8 symmetries of the square.
+  void Symmetry(bool rotate, std::vector<int> *rows, std::vector<int> *cols) {
+    rows->resize(Rows());
+    for (int x = 0; x < n_; x++)
+      for (int y = 0; y < n_; y++)
+        (*rows)[x * n_ + y] =
+            rotate ? y * n_ + n_ - 1 - x : x * n_ + n_ - 1 - y;
+    cols->resize(Cols());
+    for (int k = 0; k < n_; k++) { // Ranks, then files.
+      (*cols)[k] = rotate ? 2 * n_ - 1 - k : k;
+      (*cols)[n_ + k] = rotate ? k : 2 * n_ - 1 - k;
+    }
+    for (int k = 0; k < 2 * n_ - 1; k++) { // Diagonals, then antidiagonals.
+      (*cols)[2 * n_ + k] = 6 * n_ - 3 - k;
+      (*cols)[4 * n_ - 1 + k] = rotate ? 2 * n_ + k : 4 * n_ - 2 - k;
+    }
+  }
+
 private:
   int n_;
 };
 
+// Prints the boards to std::cout, buffered until destruction.
 class NQueensVisitor : public dlx::VisitorInterface {
 public:
   NQueensVisitor(int q = 4, int to_visit = 0) : n_(q), to_visit_(to_visit) {
@@ -31,32 +61,31 @@ public:
   }
   void SetN(int q) { n_ = q; }
   bool VisitSolution(const std::vector<int> &chosen) override {
-    static std::vector<std::vector<char>> board(n_, std::vector<char>(n_));
-    std::fill(board.begin(), board.end(), std::vector<char>(n_, '.'));
-    for (auto row_idx : chosen)
-      board[row_idx / n_][row_idx % n_] = 'Q';
+    board_.assign(n_ * (n_ + 1), '.');
     for (int i = 0; i < n_; i++)
-      for (int j = 0; j < n_; j++)
-        std::cout << board[i][j] << (j == n_ - 1 ? "\n" : "");
-    std::cout << "\n";
+      board_[i * (n_ + 1) + n_] = '\n';
+    for (auto row_idx : chosen)
+      board_[row_idx / n_ * (n_ + 1) + row_idx % n_] = 'Q';
+    out_.Put(board_.data(), board_.size());
+    out_.Put('\n');
+    out_.EndRecord();
     return to_visit_ != ++visited_;
   }
 
 private:
   int n_;
   int to_visit_, visited_;
+  // The board, row by row, each ending in a newline.
+  std::vector<char> board_;
+  dlx::OutputBuffer out_{&std::cout};
 };
 
-template <class ColumnPickingPolicy> class NQueens {
+template <class ColumnPickingPolicy, class Index = int> class NQueens {
 public:
-  NQueens(int n = 4) : n_(n) {
-    matrix_.SetN(n_);
-    dlx_.Initialize(matrix_);
-  }
+  NQueens(int n = 4) : n_(n) { Initialize(); }
   void SetN(int q) {
     n_ = q;
-    matrix_.SetN(n_);
-    dlx_.Initialize(matrix_);
+    Initialize();
   }
   void Solve(NQueensVisitor &visitor, dlx::SolutionMethod method) {
     dlx_.Solve(visitor, method);
@@ -67,9 +96,46 @@ public:
     dlx_.Solve(visitor, method);
     return visitor.Count();
   }
+  // Same as Count(..), but only searches for one solution of each
+  // class under the symmetries of the board.
+  unsigned long SymmetricCount() {
+    return dlx_.SymmetricSolve([](const std::vector<int> &) {});
+  }
+  // Same as Count(..), but saves the progress to `path` every
+  // `seconds` and resumes from there if interrupted (see
+  // dlx::DancingLinks::CheckpointedSolve(..)).
+  unsigned long CheckpointedCount(const std::string &path, double seconds) {
+    dlx::CountingVisitor<unsigned long> visitor;
+    dlx_.CheckpointedSolve(visitor, path, seconds);
+    return visitor.Count();
+  }
+  // Counts on `num_threads` threads and sums the per-thread counts.
+  unsigned int ParallelCount(int num_threads) {
+    std::vector<dlx::CountingVisitor<unsigned int>> counters(num_threads);
+    std::vector<dlx::VisitorInterface *> visitors;
+    for (auto &counter : counters)
+      visitors.push_back(&counter);
+    dlx_.ParallelSolve(visitors);
+    unsigned int count = 0;
+    for (const auto &counter : counters)
+      count += counter.Count();
+    return count;
+  }
 
 private:
+  void Initialize() {
+    matrix_.SetN(n_);
+    dlx_.Initialize(matrix_);
+    std::vector<int> rows, cols;
+    for (bool rotate : {true, false}) {
+      matrix_.Symmetry(rotate, &rows, &cols);
+      const bool added = dlx_.AddSymmetry(rows, cols);
+      assert(added);
+      (void)added;
+    }
+  }
+
   int n_;
   NQueensMatrix matrix_;
-  dlx::DancingLinks<ColumnPickingPolicy> dlx_;
+  dlx::DancingLinks<ColumnPickingPolicy, Index> dlx_;
 };
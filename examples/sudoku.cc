@@ -1,8 +1,12 @@
 #include "examples/sudoku.h"
 
 #include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -18,14 +22,82 @@ std::vector<std::string> ReadLines(const std::string &filename) {
   return lines;
 }
 
+// Solves the puzzles on `threads` threads, printing the solutions in
+// input order.
+dlx::BatchStats SolveBatch(const std::vector<std::string> &input,
+                           int threads) {
+  using Solver = Sudoku<dlx::ColumnWithLeastOnes>;
+  Solver prototype{3};
+  dlx::BatchSolver<Solver, std::string, std::string> batch{prototype, threads};
+  auto next = input.begin();
+  return batch.Run(
+      [&](std::string *line) {
+        if (next == input.end())
+          return false;
+        *line = *next++;
+        return true;
+      },
+      [](const std::string &line, Solver &sudoku) {
+        std::ostringstream out;
+        if (sudoku.SetProblem(line)) {
+          SudokuVisitor visitor{3, SudokuFormat::ONELINE, 1, &out};
+          sudoku.Solve(visitor, dlx::SolutionMethod::RECURSIVE);
+          visitor.Flush();
+        }
+        return out.str();
+      },
+      [](std::string &&solution) { std::cout << solution; });
+}
+
+// Prints the search statistics of the uniqueness test of each puzzle
+// under the given column picking policy.
+template <class ColumnPickingPolicy>
+void DumpStats(const std::vector<std::string> &input, const char *policy) {
+  Sudoku<ColumnPickingPolicy, int, dlx::SearchStats> sudoku{3};
+  for (size_t k = 0; k < input.size(); k++) {
+    if (!sudoku.SetProblem(input[k]))
+      continue;
+    sudoku.MoreThanOneSolution();
+    const auto &stats = sudoku.Stats();
+    std::cout << k << " " << policy << " nodes " << stats.nodes << " updates "
+              << stats.updates << " first " << stats.seconds_to_first_solution
+              << "s depth " << stats.nodes_per_depth.size() << "\n";
+  }
+}
+
 int main(int argc, char **argv) {
+  int threads = 0; // Zero selects the serial loop.
+  bool stats = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threads = atoi(argv[i + 1]);
+    stats = stats || std::strcmp(argv[i], "--stats") == 0;
+  }
+  const std::vector<std::string> &input{ReadLines("data/sudoku.in.txt")};
+  if (stats) {
+    DumpStats<dlx::ColumnWithLeastOnes>(input, "ColumnWithLeastOnes");
+    DumpStats<dlx::BucketedColumnWithLeastOnes>(input,
+                                                "BucketedColumnWithLeastOnes");
+    return 0;
+  }
+  if (threads > 0) {
+    dlx::BatchStats stats = SolveBatch(input, threads);
+    std::cerr << stats.InstancesPerSecond() << " puzzles/s on " << threads
+              << " threads.\n";
+    return 0;
+  }
   Sudoku<dlx::ColumnWithLeastOnes> sudoku{3};
   SudokuVisitor visitor{3, SudokuFormat::ONELINE, 1};
-  const std::vector<std::string> &input{ReadLines("data/sudoku.in.txt")};
+  int solved = 0;
+  auto start = std::chrono::steady_clock::now();
   for (const auto &line : input) {
     if (!sudoku.SetProblem(line))
       continue;
     sudoku.Solve(visitor, dlx::SolutionMethod::RECURSIVE);
+    solved++;
   }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cerr << solved / elapsed.count() << " puzzles/s serially.\n";
   return 0;
 }
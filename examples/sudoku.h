@@ -2,23 +2,26 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <string>
 #include <vector>
 
 #include "dlx.h"
 
 // n = 3 for the regular sudoku.
-class SudokuMatrix : public dlx::MatrixInterface {
+class SudokuMatrix : public dlx::SparseMatrixInterface {
 public:
   SudokuMatrix(int n = 3) : n_(n) {}
   void SetN(int n) { n_ = n; }
   // One row for each choice to be made.
   int Rows() override { return (n_ * n_) * (n_ * n_) * (n_ * n_); }
-  // Four sets of columns for each type of constraint, along with the
-  // problem specific constraints.
-  int Cols() override { return 4 * (n_ * n_) * (n_ * n_) + row_idxs_.size(); }
+  // Four sets of columns for each type of constraint.
+  int Cols() override { return 4 * (n_ * n_) * (n_ * n_); }
   int Value(int i, int j) override {
     const int width = n_ * n_;
     int l = i % width, x = (i / width) % width, y = (i / width) / width;
@@ -33,67 +36,83 @@ public:
       return (l == ox && y == oy);
     case 3: // Box
       return (l == ox && b == oy);
-    default: // Problem constraints
-      int idx = j - 4 * (n_ * n_) * (n_ * n_);
-      assert(0 <= idx && idx < row_idxs_.size());
-      return i == row_idxs_[idx];
     }
     assert(false);
     return -1;
   }
+  // Every choice satisfies one constraint of each type.
+  int NonZeros() override { return 4 * Rows(); }
+  void Row(int i, std::vector<int> *cols) override {
+    const int width = n_ * n_;
+    int l = i % width, x = (i / width) % width, y = (i / width) / width;
+    int b = (x / n_) * n_ + (y / n_);
+    *cols = {x * width + y, width * width + l * width + x,
+             2 * width * width + l * width + y,
+             3 * width * width + l * width + b};
+  }
   int FirstSecondaryColumnIndex() override { return Cols(); }
 
-  // Force particular rows in the solution.
-  void Preselect(int row_idx) { row_idxs_.push_back(row_idx); }
-  void UndoAllPreselects() { row_idxs_.resize(0); }
-
 private:
   int n_;
-  std::vector<int> row_idxs_;
 };
 
 enum class SudokuFormat { ONELINE, MULTILINE };
 
-// Decides the size, output format and visiting policy.
+// Decides the size, output format and visiting policy. Solutions are
+// written to std::cout unless another stream is supplied, through a
+// buffer that is written out by Flush() or on destruction.
 class SudokuVisitor : public dlx::VisitorInterface {
 public:
   SudokuVisitor(int n = 3, SudokuFormat fmt = SudokuFormat::MULTILINE,
-                int to_visit = 0)
-      : n_(n), fmt_(fmt), to_visit_(to_visit), visited_(0) {}
+                int to_visit = 0, std::ostream *out = &std::cout)
+      : n_(n), fmt_(fmt), to_visit_(to_visit), visited_(0), out_(out) {}
   void SetN(int n) { n_ = n; }
   void SetFormat(SudokuFormat fmt) { fmt_ = fmt; }
   bool VisitSolution(const std::vector<int> &chosen) override {
     const int width = n_ * n_;
-    static std::vector<std::vector<int>> board(width, std::vector<int>(width));
+    board_.resize(width * width);
     for (auto row_idx : chosen) {
       int l = row_idx % width, x = (row_idx / width) % width,
           y = (row_idx / width) / width;
-      board[x][y] = l + 1;
+      board_[x * width + y] = l + 1;
     }
-    for (int i = 0; i < width; i++)
+    for (int i = 0; i < width; i++) {
       for (int j = 0; j < width; j++)
-        std::cout << board[i][j]
-                  << (j == width - 1 && fmt_ == SudokuFormat::MULTILINE ? "\n"
-                                                                        : "");
-    std::cout << "\n";
+        out_.PutInt(board_[i * width + j]);
+      if (fmt_ == SudokuFormat::MULTILINE)
+        out_.Put('\n');
+    }
+    out_.Put('\n');
+    out_.EndRecord();
     return to_visit_ != ++visited_;
   }
+  void Flush() { out_.Flush(); }
 
 private:
   int n_;
   SudokuFormat fmt_;
   int to_visit_, visited_;
+  dlx::OutputBuffer out_;
+  std::vector<int> board_;
 };
 
-template <class ColumnPickingPolicy> class Sudoku {
+// The base instance (without any clues) is built once, and each problem
+// only selects the rows of its clues on the live solver. The `Engine`
+// is dlx::DancingLinks or another solver with its interface, such as
+// dlx::DancingCells or dlx::AdaptiveSolver.
+template <class ColumnPickingPolicy, class Index = int,
+          class StatsPolicy = dlx::NoStats,
+          template <class, class, class> class Engine = dlx::DancingLinks>
+class Sudoku {
 public:
-  Sudoku(int n = 3) : n_(n) {
+  Sudoku(int n = 3) : n_(n), consistent_(true) {
     matrix_.SetN(n_);
     dlx_.Initialize(matrix_);
   }
   // Return value indicates if the problem was correctly parsed.
   bool SetProblem(const std::string &problem) {
-    matrix_.UndoAllPreselects();
+    dlx_.UnselectAllRows();
+    consistent_ = true;
     const int width = n_ * n_;
     auto valid_character = [](char c) {
       return c == '.' || ('0' <= c && c <= '9');
@@ -105,40 +124,217 @@ public:
     for (int k = 0; pos != width * width; k++) {
       char c = problem[k];
       if (valid_character(c)) {
-        if (c != '.' && c != '0') {
+        if (c != '.' && c != '0' && consistent_) {
           int i = pos / width, j = pos % width;
-          matrix_.Preselect(j * width * width + i * width + (c - '1'));
+          // Clues that contradict each other leave no solutions.
+          consistent_ = dlx_.SelectRow(j * width * width + i * width + (c - '1'));
         }
         pos++;
       }
     }
-    dlx_.Initialize(matrix_);
     return true;
   }
   void SetN(int n) {
     n_ = n;
+    consistent_ = true;
     matrix_.SetN(n_);
     dlx_.Initialize(matrix_);
   }
   void Solve(SudokuVisitor &visitor,
              dlx::SolutionMethod method = dlx::SolutionMethod::ITERATIVE) {
-    dlx_.Solve(visitor, method);
+    if (consistent_)
+      dlx_.Solve(visitor, method);
   }
   unsigned int
   Count(dlx::SolutionMethod method = dlx::SolutionMethod::ITERATIVE) {
     dlx::CountingVisitor<unsigned int> visitor;
-    dlx_.Solve(visitor, method);
+    if (consistent_)
+      dlx_.Solve(visitor, method);
     return visitor.Count();
   }
+  // Counts on `num_threads` threads and sums the per-thread counts.
+  unsigned int ParallelCount(int num_threads) {
+    if (!consistent_)
+      return 0;
+    std::vector<dlx::CountingVisitor<unsigned int>> counters(num_threads);
+    std::vector<dlx::VisitorInterface *> visitors;
+    for (auto &counter : counters)
+      visitors.push_back(&counter);
+    dlx_.ParallelSolve(visitors);
+    unsigned int count = 0;
+    for (const auto &counter : counters)
+      count += counter.Count();
+    return count;
+  }
+  // Statistics of the last search.
+  const StatsPolicy &Stats() const { return dlx_.Stats(); }
   bool MoreThanOneSolution(
       dlx::SolutionMethod method = dlx::SolutionMethod::ITERATIVE) {
     dlx::UniquenessTestingVisitor visitor;
-    dlx_.Solve(visitor, method);
+    if (consistent_)
+      dlx_.Solve(visitor, method);
     return visitor.MoreThanOneSolution();
   }
 
 private:
   int n_;
+  // False when the clues of the current problem conflict.
+  bool consistent_;
+  SudokuMatrix matrix_;
+  Engine<ColumnPickingPolicy, Index, StatsPolicy> dlx_;
+};
+
+// Generates random puzzles with a unique solution that are minimal:
+// dropping any of their clues would allow another solution. Puzzles
+// are grids of n^2 x n^2 cells, row by row, holding 1 to n^2 for
+// clues and 0 for blanks, and depend only on `seed` and `max_nodes`.
+// Proving that a clue can go takes longer as clues get scarce, which
+// for n = 4 and 5 adds up: with `max_nodes` > 0, a clue whose search
+// for another solution exceeds that many nodes is kept instead, so
+// that puzzles stay unique but may not be minimal.
+//
+// A single live solver of the blank grid serves for everything: a
+// random complete grid is the first solution with a random first row,
+// shuffled by symmetries of the grid, and its clues are then dropped
+// in random order, each as long as the rest leave a unique solution.
+// Every such probe selects the clues decided kept and those still
+// undecided, through SelectRow(..) and UnselectRow(), which must come
+// in LIFO order. Deciding them by halves (see Decide(..)) takes
+// O(log(cells)) selections per probe, and no rebuild of the arena.
+class SudokuGenerator {
+public:
+  SudokuGenerator(int n = 3, uint32_t seed = 0, long max_nodes = 0)
+      : n_(n), width_(n * n),
+        max_nodes_(max_nodes > 0 ? max_nodes
+                                 : std::numeric_limits<long>::max()),
+        gen_(seed) {
+    matrix_.SetN(n_);
+    dlx_.Initialize(matrix_);
+    dlx_.SetPropagation(dlx::Propagation::SINGLETONS);
+  }
+
+  // The next puzzle.
+  const std::vector<int> &Next() {
+    const int ncells = width_ * width_;
+    RandomGrid();
+    order_.resize(ncells);
+    std::iota(order_.begin(), order_.end(), 0);
+    std::shuffle(order_.begin(), order_.end(), gen_);
+    keep_.assign(ncells, false);
+    Decide(0, ncells);
+    puzzle_.assign(ncells, 0);
+    for (int k = 0; k < ncells; k++)
+      if (keep_[k])
+        puzzle_[order_[k]] = solution_[order_[k]];
+    return puzzle_;
+  }
+
+  // The solution of the last puzzle.
+  const std::vector<int> &Solution() const { return solution_; }
+
+private:
+  // Row of the matrix placing the digit of `solution_` at `cell`.
+  int RowIndex(int cell) const {
+    const int x = cell / width_, y = cell % width_;
+    return y * width_ * width_ + x * width_ + solution_[cell] - 1;
+  }
+
+  // Sets `solution_` to a random complete grid.
+  void RandomGrid() {
+    std::vector<int> digits(width_);
+    std::iota(digits.begin(), digits.end(), 0);
+    std::shuffle(digits.begin(), digits.end(), gen_);
+    for (int y = 0; y < width_; y++)
+      dlx_.SelectRow(y * width_ * width_ + digits[y]);
+    std::vector<int> grid(width_ * width_);
+    dlx_.Solve([&](const std::vector<int> &chosen) {
+      for (int row_idx : chosen) {
+        const int l = row_idx % width_, x = (row_idx / width_) % width_,
+                  y = row_idx / width_ / width_;
+        grid[x * width_ + y] = l + 1;
+      }
+      return false;
+    });
+    dlx_.UnselectAllRows();
+    // Permuting the bands, the rows of each band, the stacks and the
+    // columns of each stack, and transposing, keep the grid valid.
+    auto lines = [this]() {
+      std::vector<int> blocks(n_), map;
+      std::iota(blocks.begin(), blocks.end(), 0);
+      std::shuffle(blocks.begin(), blocks.end(), gen_);
+      for (int block : blocks) {
+        std::vector<int> inner(n_);
+        std::iota(inner.begin(), inner.end(), block * n_);
+        std::shuffle(inner.begin(), inner.end(), gen_);
+        map.insert(map.end(), inner.begin(), inner.end());
+      }
+      return map;
+    };
+    const std::vector<int> rows = lines(), cols = lines();
+    const bool transpose = std::bernoulli_distribution()(gen_);
+    solution_.resize(width_ * width_);
+    for (int x = 0; x < width_; x++) {
+      for (int y = 0; y < width_; y++) {
+        const int cell = rows[x] * width_ + cols[y];
+        solution_[transpose ? y * width_ + x : x * width_ + y] = grid[cell];
+      }
+    }
+  }
+
+  // Decides which clues order_[lo..hi) to keep, with those decided
+  // kept in order_[0..lo) and all of order_[hi..) selected, and leaves
+  // the selection as it was. A clue is decided with all the others
+  // selected but those dropped before it, so that a puzzle keeps it
+  // only if dropping it would allow another solution (and then so
+  // would any puzzle with fewer clues).
+  void Decide(int lo, int hi) {
+    if (hi - lo == 1) {
+      // Another solution would put another digit in the cell.
+      const int cell = order_[lo], row_idx = RowIndex(cell);
+      const int first = row_idx - (solution_[cell] - 1);
+      for (int l = 0; l < width_ && !keep_[lo]; l++) {
+        if (first + l != row_idx && dlx_.SelectRow(first + l)) {
+          keep_[lo] = dlx_.RestartSolve([](const std::vector<int> &) {},
+                                        max_nodes_,
+                                        dlx::RestartSchedule::GEOMETRIC, 1) ||
+                      dlx_.Stats().nodes >= max_nodes_; // Cut short.
+          dlx_.UnselectRow();
+        }
+      }
+      return;
+    }
+    const int mid = (lo + hi) / 2;
+    for (int k = mid; k < hi; k++)
+      Select(order_[k]);
+    Decide(lo, mid);
+    for (int k = mid; k < hi; k++)
+      dlx_.UnselectRow();
+    int kept = 0;
+    for (int k = lo; k < mid; k++) {
+      if (keep_[k]) {
+        Select(order_[k]);
+        kept++;
+      }
+    }
+    Decide(mid, hi);
+    for (; kept > 0; kept--)
+      dlx_.UnselectRow();
+  }
+
+  void Select(int cell) {
+    const bool consistent = dlx_.SelectRow(RowIndex(cell));
+    assert(consistent);
+    (void)consistent;
+  }
+
+  int n_, width_;
+  long max_nodes_;
+  std::mt19937 gen_;
   SudokuMatrix matrix_;
-  dlx::DancingLinks<ColumnPickingPolicy> dlx_;
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> dlx_;
+  std::vector<int> solution_, puzzle_;
+  // Cells in the order their clues are dropped, and whether each is
+  // kept.
+  std::vector<int> order_;
+  std::vector<bool> keep_;
 };
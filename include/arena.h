@@ -0,0 +1,181 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace dlx {
+
+// A file mapped privately into memory: its pages are read on first
+// access and copied on first write, so that a solver can search
+// directly in the mapping while the file itself is never modified.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr)
+      munmap(data_, size_);
+  }
+
+  // Returns false if `path` cannot be mapped (or is empty).
+  bool Open(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<char *>(data);
+        size_ = st.st_size;
+      }
+    }
+    close(fd);
+    return data_ != nullptr;
+  }
+
+  char *Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+private:
+  char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// The subset of std::vector used for the arrays of DancingLinks, which
+// either owns its elements or views them in a MappedFile (see View(..)).
+// Views are kept as long as they are read and written in place, or
+// shrunk; growing one first copies it into owned memory, as does
+// copying the vector.
+template <class T> class ArenaVector {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "ArenaVector elements are stored in files as they are.");
+
+public:
+  ArenaVector() = default;
+  ArenaVector(const ArenaVector &other) {
+    Grow(other.size_);
+    std::copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  }
+  ArenaVector(ArenaVector &&other) noexcept { swap(other); }
+  ArenaVector &operator=(ArenaVector other) {
+    swap(other);
+    return *this;
+  }
+  void swap(ArenaVector &other) {
+    owned_.swap(other.owned_);
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(capacity_, other.capacity_);
+    mapping_.swap(other.mapping_);
+  }
+
+  T &operator[](size_t k) { return data_[k]; }
+  const T &operator[](size_t k) const { return data_[k]; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T *begin() { return data_; }
+  T *end() { return data_ + size_; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  T &back() { return data_[size_ - 1]; }
+
+  void reserve(size_t n) {
+    if (n > capacity_)
+      Grow(n);
+  }
+  void resize(size_t n, const T &value = T()) {
+    if (n > capacity_)
+      Grow(std::max(n, 2 * capacity_));
+    std::fill(data_ + std::min(n, size_), data_ + n, value);
+    size_ = n;
+  }
+  void assign(size_t n, const T &value) {
+    clear();
+    resize(n, value);
+  }
+  void clear() {
+    if (mapping_ != nullptr) {
+      data_ = nullptr;
+      capacity_ = 0;
+      mapping_.reset();
+    }
+    size_ = 0;
+  }
+  void push_back(const T &value) {
+    if (size_ == capacity_)
+      Grow(std::max<size_t>(16, 2 * capacity_));
+    data_[size_++] = value;
+  }
+  void emplace_back(const T &value) { push_back(value); }
+
+  // Views the `size` elements at `data`, which `mapping` keeps alive.
+  void View(T *data, size_t size, std::shared_ptr<const MappedFile> mapping) {
+    owned_.reset();
+    data_ = data;
+    size_ = capacity_ = size;
+    mapping_ = std::move(mapping);
+  }
+
+private:
+  // Moves the elements to owned memory for `capacity` of them.
+  void Grow(size_t capacity) {
+    std::unique_ptr<T[]> owned{new T[capacity]};
+    std::copy(data_, data_ + size_, owned.get());
+    owned_ = std::move(owned);
+    data_ = owned_.get();
+    capacity_ = capacity;
+    mapping_.reset();
+  }
+
+  std::unique_ptr<T[]> owned_;
+  T *data_ = nullptr;
+  size_t size_ = 0, capacity_ = 0;
+  std::shared_ptr<const MappedFile> mapping_; // Null unless a view.
+};
+
+// Layout of the files written by DancingLinks::SaveArena(..): this
+// header, then each array of the instance at the offset given here.
+// The arrays are stored as they are in memory, so a file can only be
+// loaded on a machine with the same byte order and by a solver with
+// the same Index type.
+struct ArenaFileHeader {
+  static constexpr char kMagic[8] = {'d', 'l', 'x', 'a', 'r', 'e', 'n', 'a'};
+  static constexpr uint32_t kVersion = 2;
+  static constexpr uint32_t kByteOrder = 0x01020304;
+  // Arrays start at multiples of kAlignment bytes.
+  static constexpr uint64_t kAlignment = 64;
+  enum Section {
+    CELLS,   // C_
+    ROW_IDS, // I_
+    COLORS,  // K_
+    COUNTS,  // O_
+    ROWS,    // R_
+    NEED,    // need_
+    ROOM,    // room_
+    FIXED,   // selected_, the rows fixed by Reduce(..)
+    NUM_SECTIONS
+  };
+
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t index_size; // sizeof(Index).
+  int32_t nrows, ncols, sec_idx;
+  uint64_t offset[NUM_SECTIONS]; // In bytes, from the start of the file.
+  uint64_t length[NUM_SECTIONS]; // In elements.
+};
+
+} // namespace dlx
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dlx {
+
+// Summary of a BatchSolver::Run(..).
+struct BatchStats {
+  long instances = 0;
+  double seconds = 0;
+  double InstancesPerSecond() const {
+    return seconds > 0 ? instances / seconds : 0;
+  }
+};
+
+// Solves a stream of independent instances on a pool of threads. Each
+// thread owns a copy of the `prototype` solver (typically a
+// DancingLinks object holding a shared base matrix, or an example
+// class like Sudoku that wraps one) and reuses it for every job it
+// takes, so the base instance is built only once per thread.
+//
+// Run(..) is driven by three callables:
+//
+// - bool source(Job *job) produces the next job, or returns false at
+//   the end of the stream. Calls are serialized.
+//
+// - Result solve(const Job &job, Solver &solver) solves one job on a
+//   worker's solver and must leave the solver ready for the next job
+//   (e.g. by undoing its row selections in LIFO order).
+//
+// - void sink(Result &&result) consumes the results. Calls are
+//   serialized and, if the batch is `ordered`, happen in the order in
+//   which the jobs were produced.
+template <class Solver, class Job, class Result> class BatchSolver {
+public:
+  BatchSolver(const Solver &prototype, int num_threads, bool ordered = true)
+      : prototype_(prototype), num_threads_(num_threads), ordered_(ordered) {}
+
+  template <class Source, class Solve, class Sink>
+  BatchStats Run(Source &&source, Solve &&solve, Sink &&sink) {
+    std::mutex source_mutex, sink_mutex;
+    long produced = 0, consumed = 0;
+    std::map<long, Result> pending; // Results waiting for their turn.
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads_; t++) {
+      threads.emplace_back([&]() {
+        Solver solver{prototype_};
+        Job job;
+        while (true) {
+          long seq;
+          {
+            std::lock_guard<std::mutex> lock(source_mutex);
+            if (!source(&job))
+              break;
+            seq = produced++;
+          }
+          Result result = solve(job, solver);
+          std::lock_guard<std::mutex> lock(sink_mutex);
+          if (!ordered_) {
+            sink(std::move(result));
+            continue;
+          }
+          pending.emplace(seq, std::move(result));
+          for (auto it = pending.begin();
+               it != pending.end() && it->first == consumed;
+               it = pending.erase(it), consumed++) {
+            sink(std::move(it->second));
+          }
+        }
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    BatchStats stats;
+    stats.instances = produced;
+    stats.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    return stats;
+  }
+
+private:
+  const Solver &prototype_;
+  int num_threads_;
+  bool ordered_;
+};
+
+} // namespace dlx
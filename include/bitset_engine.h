@@ -0,0 +1,551 @@
+#pragma once
+
+#include "dlx_internal.h"
+#include "matrix.h"
+#include "policies.h"
+#include "stats.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dlx {
+
+template <class ColumnPickingPolicy, class Index, class StatsPolicy>
+class BitsetEngine;
+
+// Column picking for BitsetEngine, which like CellsColumnPicker maps
+// each policy to the same choice it makes on DancingLinks. Besides
+// the column, ChooseColumn(..) stores its number of live rows into
+// *count. Specialize this template to use another policy.
+template <class ColumnPickingPolicy> struct BitsetColumnPicker {
+  static_assert(sizeof(ColumnPickingPolicy) == 0,
+                "Specialize BitsetColumnPicker for this policy.");
+};
+
+template <> struct BitsetColumnPicker<FirstAvailableColumn> {
+  template <class T>
+  static int ChooseColumn(const T &bs, int level, int *count) {
+    const uint64_t *open = bs.Open(level);
+    for (int w = 0; w < bs.col_words_; w++) {
+      if (open[w] != 0) {
+        int col = w * 64 + __builtin_ctzll(open[w]);
+        *count = bs.Counts(level)[col];
+        return col;
+      }
+    }
+    return -1;
+  }
+};
+
+template <> struct BitsetColumnPicker<LastAvailableColumn> {
+  template <class T>
+  static int ChooseColumn(const T &bs, int level, int *count) {
+    const uint64_t *open = bs.Open(level);
+    for (int w = bs.col_words_; w-- > 0;) {
+      if (open[w] != 0) {
+        int col = w * 64 + 63 - __builtin_clzll(open[w]);
+        *count = bs.Counts(level)[col];
+        return col;
+      }
+    }
+    return -1;
+  }
+};
+
+template <> struct BitsetColumnPicker<UniformlyRandomColumn> {
+  template <class T>
+  static int ChooseColumn(const T &bs, int level, int *count) {
+    const uint64_t *open = bs.Open(level);
+    int nopen = 0;
+    for (int w = 0; w < bs.col_words_; w++)
+      nopen += __builtin_popcountll(open[w]);
+    if (nopen == 0)
+      return -1;
+    int k = bs.random_.Below(nopen);
+    for (int w = 0;; w++) {
+      for (uint64_t bits = open[w]; bits != 0; bits &= bits - 1) {
+        if (k-- == 0) {
+          int col = w * 64 + __builtin_ctzll(bits);
+          *count = bs.Counts(level)[col];
+          return col;
+        }
+      }
+    }
+  }
+};
+
+// Fewest live rows, ties broken towards the lowest column index.
+template <> struct BitsetColumnPicker<ColumnWithLeastOnes> {
+  template <class T>
+  static int ChooseColumn(const T &bs, int level, int *count) {
+    const uint64_t *open = bs.Open(level);
+    const int *counts = bs.Counts(level);
+    int best = -1, best_val = std::numeric_limits<int>::max();
+    for (int w = 0; w < bs.col_words_; w++) {
+      for (uint64_t bits = open[w]; bits != 0; bits &= bits - 1) {
+        int col = w * 64 + __builtin_ctzll(bits);
+        int val = counts[col];
+        if (val < best_val) {
+          best = col;
+          best_val = val;
+          if (val == 0) { // Cannot do better.
+            *count = 0;
+            return best;
+          }
+        }
+      }
+    }
+    *count = best_val;
+    return best;
+  }
+};
+
+template <>
+struct BitsetColumnPicker<BucketedColumnWithLeastOnes>
+    : BitsetColumnPicker<ColumnWithLeastOnes> {};
+
+// Algorithm X on bitsets, for small exact cover instances (with
+// secondary columns) such as a 9x9 sudoku. Each column is the bitset
+// of its rows, and each level of the search keeps the bitset of the
+// rows still live (disjoint from all the chosen ones), that of the
+// primary columns still open and their numbers of live rows. Choosing
+// a row clears the rows of its columns from a copy of the live set, a
+// few word operations per column (vectorized with AVX2 when
+// available), and the counts drop by the rows that died, found from
+// the difference of both sets. Backtracking just returns to the
+// previous level, so there is nothing to undo.
+//
+// Counting the live rows of every column with popcounts at every node
+// would be simpler, but costs a full scan of each bitset since most
+// of their words are empty deep in the search; the counts keep the
+// choice of a column as cheap as on DancingLinks.
+//
+// The interface, policies and order of solutions are those of
+// DancingCells. For Stats(), a cover is the choice of a row (with
+// the counts it decremented as its updates) and uncovers are free.
+// Index is only there for interface compatibility.
+//
+// Every level copies its bitsets, so this pays off only while they
+// are short: see Fits(..) and AdaptiveSolver below.
+template <class ColumnPickingPolicy = ColumnWithLeastOnes, class Index = int,
+          class StatsPolicy = NoStats>
+class BitsetEngine {
+  template <class> friend struct BitsetColumnPicker;
+  using Picker = BitsetColumnPicker<ColumnPickingPolicy>;
+
+public:
+  // Limits of the instances for which this engine is worthwhile.
+  static constexpr int kMaxColumns = 4096;
+  static constexpr long kMaxWords = 1 << 15; // Of all column bitsets.
+
+  static bool Fits(int nrows, int ncols) {
+    return ncols <= kMaxColumns && long(ncols) * Words(nrows) <= kMaxWords;
+  }
+
+  // Default construction creates a trivial instance.
+  BitsetEngine() { InitializeColumns(0, 0, 0); }
+
+  // Setup the internal data structures to solve the input instance.
+  BitsetEngine(MatrixInterface &matrix) { Initialize(matrix); }
+  BitsetEngine(SparseMatrixInterface &matrix) { Initialize(matrix); }
+
+  // Initialize by probing every entry of a dense matrix. Returns false,
+  // leaving an instance without solutions, if the matrix has bounds or
+  // colors (see IsExactCover(..)).
+  bool Initialize(MatrixInterface &matrix) {
+    if (!IsExactCover(matrix))
+      return Unsupported();
+    InitializeColumns(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    for (int i = 0; i < nrows_; i++) {
+      for (int j = 0; j < ncols_; j++)
+        if (matrix.Value(i, j) == 1)
+          AppendCell(i, j);
+      first_.push_back(cols_.size());
+    }
+    return true;
+  }
+
+  // Initialize from a sparse matrix in O(rows + cols + ones). Same
+  // result.
+  bool Initialize(SparseMatrixInterface &matrix) {
+    if (!IsExactCover(matrix))
+      return Unsupported();
+    InitializeColumns(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    std::vector<int> cols;
+    for (int i = 0; i < nrows_; i++) {
+      matrix.Row(i, &cols);
+      for (int j : cols)
+        AppendCell(i, j);
+      first_.push_back(cols_.size());
+    }
+    return true;
+  }
+
+  // See DancingLinks::Solve(..).
+  void Solve(VisitorInterface &visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    (method == SolutionMethod::RECURSIVE) ? RSolve(visitor) : ISolve(visitor);
+  }
+  template <class Visitor>
+  void Solve(Visitor &&visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    (method == SolutionMethod::RECURSIVE) ? RSolve(visitor) : ISolve(visitor);
+  }
+
+  // See DancingLinks::SelectRow(..). A row is rejected exactly when it
+  // is no longer live.
+  bool SelectRow(int row_idx) {
+    assert(0 <= row_idx && row_idx < nrows_);
+    const int level = selected_.size();
+    if (!(Live(level)[row_idx / 64] >> (row_idx % 64) & 1))
+      return false;
+    Reserve(level + 2);
+    Advance(level, row_idx);
+    selected_.push_back(row_idx);
+    return true;
+  }
+
+  // See DancingLinks::UnselectRow(..). The previous level is intact.
+  void UnselectRow() {
+    assert(!selected_.empty());
+    selected_.pop_back();
+  }
+
+  void UnselectAllRows() { selected_.clear(); }
+
+  const std::vector<int> &SelectedRows() const { return selected_; }
+
+  // Statistics of the last ISolve(..)/RSolve(..).
+  const StatsPolicy &Stats() const { return stats_; }
+
+  // Seeds the choices of randomized policies (see RandomSource).
+  void Seed(uint32_t seed) { random_.Seed(seed); }
+
+private:
+  // One level of the search tree: the chosen column and the row
+  // currently tried.
+  struct Frame {
+    int col, row;
+  };
+
+  static int Words(int bits) { return (bits + 63) / 64; }
+
+  // Solve iteratively, on a preallocated stack of frames.
+  template <class Visitor> void ISolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    const int base = selected_.size();
+    Reserve(base + sec_col_ + 1);
+    int depth = 0;
+    bool should_continue = true; // Controls whether to explore new branches.
+    bool descend = true;         // Whether to extend the current branch.
+    while (true) {
+      if (descend) {
+        int count = 0, col = Picker::ChooseColumn(*this, base + depth, &count);
+        stats_.Node(depth, count);
+        if (col == -1) { // Found a solution.
+          stats_.Solution();
+          should_continue = VisitChosen(visitor, chosen_);
+        } else if (count != 0) {
+          int row = NextRow(base + depth, col, 0);
+          frames_[depth] = {col, row};
+          ChooseRow(base + depth++, row);
+          continue;
+        }
+      }
+      // Backtrack to the deepest level with an untried row.
+      if (depth == 0)
+        break;
+      Frame &f = frames_[depth - 1];
+      UnchooseRow();
+      f.row = should_continue ? NextRow(base + depth - 1, f.col, f.row + 1)
+                              : -1;
+      descend = f.row != -1;
+      if (descend)
+        ChooseRow(base + depth - 1, f.row);
+      else
+        depth--;
+    }
+  }
+
+  // Solve recursively.
+  template <class Visitor> void RSolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    Reserve(selected_.size() + sec_col_ + 1);
+    RSearch(visitor, selected_.size());
+  }
+
+  // Recursive body of RSolve(..).
+  template <class Visitor> bool RSearch(Visitor &visitor, int level) {
+    int count = 0, col = Picker::ChooseColumn(*this, level, &count);
+    stats_.Node(level - selected_.size(), count);
+    if (col == -1) {
+      stats_.Solution();
+      return VisitChosen(visitor, chosen_);
+    }
+    bool should_continue = true;
+    for (int row = NextRow(level, col, 0); should_continue && row != -1;
+         row = NextRow(level, col, row + 1)) {
+      ChooseRow(level, row);
+      should_continue = RSearch(visitor, level + 1);
+      UnchooseRow();
+    }
+    return should_continue;
+  }
+
+  // Extends the partial solution by the row, on the next level.
+  void ChooseRow(int level, int row_idx) {
+    long updates = Advance(level, row_idx);
+    chosen_.push_back(row_idx);
+    stats_.Cover(updates);
+  }
+
+  // Inverse of ChooseRow(..).
+  void UnchooseRow() {
+    chosen_.pop_back();
+    stats_.Uncover(0);
+  }
+
+  // Sets the next level to this one with the row chosen: the rows
+  // sharing one of its columns die, and its primary columns close.
+  // Returns the number of counts decremented.
+  long Advance(int level, int row_idx) {
+    const uint64_t *live = Live(level);
+    uint64_t *next_live = Live(level + 1);
+    for (int x = first_[row_idx]; x < first_[row_idx + 1]; x++) {
+      AndNot(next_live, live, Column(cols_[x]), row_words_);
+      live = next_live;
+    }
+    if (live != next_live) // Empty row.
+      std::copy(live, live + row_words_, next_live);
+    uint64_t *next_open = Open(level + 1);
+    std::copy(Open(level), Open(level) + col_words_, next_open);
+    for (int x = first_[row_idx]; x < first_[row_idx + 1]; x++)
+      if (cols_[x] < sec_col_)
+        next_open[cols_[x] / 64] &= ~(uint64_t(1) << (cols_[x] % 64));
+    int *next_counts = Counts(level + 1);
+    std::copy(Counts(level), Counts(level) + sec_col_, next_counts);
+    long updates = 0;
+    live = Live(level);
+    for (int w = 0; w < row_words_; w++) {
+      for (uint64_t dead = live[w] & ~next_live[w]; dead != 0;
+           dead &= dead - 1) {
+        int i = w * 64 + __builtin_ctzll(dead);
+        for (int x = first_[i]; x < first_[i + 1]; x++) {
+          if (cols_[x] < sec_col_) {
+            next_counts[cols_[x]]--;
+            updates++;
+          }
+        }
+      }
+    }
+    return updates;
+  }
+
+  // dst = a & ~b, word by word. dst may be a.
+  static void AndNot(uint64_t *dst, const uint64_t *a, const uint64_t *b,
+                     int words) {
+    int w = 0;
+#if defined(__AVX2__)
+    for (; w + 4 <= words; w += 4) {
+      __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + w));
+      __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + w));
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + w),
+                          _mm256_andnot_si256(vb, va));
+    }
+#endif
+    for (; w < words; w++)
+      dst[w] = a[w] & ~b[w];
+  }
+
+  // The first live row of the column at the level from `from` on, or
+  // -1 if none.
+  int NextRow(int level, int col, int from) const {
+    const uint64_t *live = Live(level), *rows = Column(col);
+    for (int w = from / 64; w < row_words_; w++) {
+      uint64_t bits = live[w] & rows[w];
+      if (w == from / 64)
+        bits &= ~uint64_t(0) << (from % 64);
+      if (bits != 0)
+        return w * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+  }
+
+  const uint64_t *Column(int col) const {
+    return &columns_[size_t(col) * row_words_];
+  }
+  const uint64_t *Live(int level) const {
+    return &live_[size_t(level) * row_words_];
+  }
+  uint64_t *Live(int level) { return &live_[size_t(level) * row_words_]; }
+  const uint64_t *Open(int level) const {
+    return &open_[size_t(level) * col_words_];
+  }
+  uint64_t *Open(int level) { return &open_[size_t(level) * col_words_]; }
+  const int *Counts(int level) const {
+    return &counts_[size_t(level) * sec_col_];
+  }
+  int *Counts(int level) { return &counts_[size_t(level) * sec_col_]; }
+
+  // Makes room for the given number of levels.
+  void Reserve(int levels) {
+    if (live_.size() < size_t(levels) * row_words_)
+      live_.resize(size_t(levels) * row_words_);
+    if (open_.size() < size_t(levels) * col_words_)
+      open_.resize(size_t(levels) * col_words_);
+    if (counts_.size() < size_t(levels) * sec_col_)
+      counts_.resize(size_t(levels) * sec_col_);
+  }
+
+  // Resets to an instance with the given dimensions and no 1s, where
+  // the first level has every row live and every primary column open.
+  void InitializeColumns(int nrows, int ncols, int sec_col) {
+    nrows_ = nrows;
+    ncols_ = ncols;
+    sec_col_ = sec_col;
+    row_words_ = Words(nrows);
+    col_words_ = Words(sec_col);
+    columns_.assign(size_t(ncols) * row_words_, 0);
+    live_.assign(row_words_, 0);
+    open_.assign(col_words_, 0);
+    counts_.assign(sec_col, 0);
+    for (int i = 0; i < nrows; i++)
+      live_[i / 64] |= uint64_t(1) << (i % 64);
+    for (int j = 0; j < sec_col; j++)
+      open_[j / 64] |= uint64_t(1) << (j % 64);
+    first_.assign(1, 0);
+    cols_.clear();
+    selected_.clear();
+    frames_.resize(sec_col);
+    chosen_.reserve(nrows);
+  }
+
+  // Only exact cover instances are supported. Others are replaced by
+  // a single primary column that no row covers.
+  bool Unsupported() {
+    InitializeColumns(0, 1, 1);
+    return false;
+  }
+
+  void AppendCell(int row_idx, int col) {
+    assert(0 <= col && col < ncols_);
+    cols_.push_back(col);
+    if (col < sec_col_)
+      counts_[col]++;
+    columns_[size_t(col) * row_words_ + row_idx / 64] |= uint64_t(1)
+                                                         << (row_idx % 64);
+  }
+
+  // Number of rows and columns of the instance, the index of the
+  // first secondary column and the words of the bitsets of rows and
+  // of primary columns.
+  int nrows_, ncols_, sec_col_, row_words_, col_words_;
+  // The columns of row i are cols_[first_[i]] .. cols_[first_[i + 1] - 1].
+  std::vector<int> first_, cols_;
+  // The bitset of the rows of each column.
+  std::vector<uint64_t> columns_;
+  // The live rows, open primary columns and their counts of live rows
+  // at each level: one for every selected row and every chosen one,
+  // after the first.
+  std::vector<uint64_t> live_, open_;
+  std::vector<int> counts_;
+  // Rows forced into the solution through SelectRow(..), in order.
+  std::vector<int> selected_;
+  // Preallocated search stack of ISolve(..), and the partial solution.
+  std::vector<Frame> frames_;
+  std::vector<int> chosen_;
+  // Observer of the search (see stats.h).
+  StatsPolicy stats_;
+  RandomSource random_;
+};
+
+// Solves on BitsetEngine when the instance fits (see
+// BitsetEngine::Fits(..)) and is a plain exact cover instance, and on
+// DancingLinks otherwise. The interface is that of BitsetEngine.
+template <class ColumnPickingPolicy = ColumnWithLeastOnes, class Index = int,
+          class StatsPolicy = NoStats>
+class AdaptiveSolver {
+  using Bits = BitsetEngine<ColumnPickingPolicy, Index, StatsPolicy>;
+  using Links = DancingLinks<ColumnPickingPolicy, Index, StatsPolicy>;
+
+public:
+  AdaptiveSolver() = default;
+  AdaptiveSolver(MatrixInterface &matrix) { Initialize(matrix); }
+  AdaptiveSolver(SparseMatrixInterface &matrix) { Initialize(matrix); }
+
+  void Initialize(MatrixInterface &matrix) {
+    use_bits_ = Bits::Fits(matrix.Rows(), matrix.Cols()) &&
+                IsExactCover(matrix);
+    Dispatch(matrix);
+  }
+  void Initialize(SparseMatrixInterface &matrix) {
+    use_bits_ = Bits::Fits(matrix.Rows(), matrix.Cols()) &&
+                IsExactCover(matrix);
+    Dispatch(matrix);
+  }
+
+  // Whether the current instance is solved on bitsets.
+  bool UsesBitsets() const { return use_bits_; }
+
+  void Solve(VisitorInterface &visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    use_bits_ ? bits_.Solve(visitor, method) : links_.Solve(visitor, method);
+  }
+  template <class Visitor>
+  void Solve(Visitor &&visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    use_bits_ ? bits_.Solve(visitor, method) : links_.Solve(visitor, method);
+  }
+
+  bool SelectRow(int row_idx) {
+    return use_bits_ ? bits_.SelectRow(row_idx) : links_.SelectRow(row_idx);
+  }
+  void UnselectRow() { use_bits_ ? bits_.UnselectRow() : links_.UnselectRow(); }
+  void UnselectAllRows() {
+    use_bits_ ? bits_.UnselectAllRows() : links_.UnselectAllRows();
+  }
+  const std::vector<int> &SelectedRows() const {
+    return use_bits_ ? bits_.SelectedRows() : links_.SelectedRows();
+  }
+
+  const StatsPolicy &Stats() const {
+    return use_bits_ ? bits_.Stats() : links_.Stats();
+  }
+
+  // Seeds randomized policies on both engines. (DancingLinks only has
+  // Seed(..) with such a policy.)
+  void Seed(uint32_t seed) {
+    bits_.Seed(seed);
+    links_.Seed(seed);
+  }
+
+private:
+  // Initializes the engine in use and releases the other one.
+  template <class Matrix> void Dispatch(Matrix &matrix) {
+    if (use_bits_) {
+      bits_.Initialize(matrix);
+      links_ = Links{};
+    } else {
+      links_.Initialize(matrix);
+      bits_ = Bits{};
+    }
+  }
+
+  bool use_bits_ = true;
+  Bits bits_;
+  Links links_;
+};
+
+} // namespace dlx
@@ -4,11 +4,11 @@ namespace dlx {
 
 // An exact cover input instance is a matrix of 1s and 0s. A Cell is
 // common structure to hold, and link in four directions, the Column
-// Headers and the 1s in the matrix.
-struct Cell {
-  int l, r, u, d; // Arena indices of the cell's neighbors.
-  int h;          // Arena index of the cell's header.
-  int row_idx;    // Row index (in the matrix) of the cell.
+// Headers and the 1s in the matrix. Only the links walked by the
+// search live here; the row index of each cell is stored separately.
+template <class Index = int> struct Cell {
+  Index l, r, u, d; // Arena indices of the cell's neighbors.
+  Index h;          // Arena index of the cell's header.
 };
 
 } // namespace dlx
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "visitor.h"
+
+namespace dlx {
+
+// A suspended search of DancingLinks, stated in terms of the input
+// matrix so that it can be resumed by a fresh process on an instance
+// built from the same input (see DancingLinks::CheckpointedSolve(..)).
+// It takes O(depth) space, the untried rows of each level being those
+// after the tried one in the order of the column.
+struct Checkpoint {
+  // Rows selected through SelectRow(..) when the search started.
+  std::vector<int> selected;
+  // The column chosen at each level of the current branch, and the
+  // row tried there.
+  std::vector<int> columns, rows;
+  // Whether to extend the current branch, or move on to the next one.
+  bool descend = true;
+  // State of the visitor (see SaveVisitor(..)).
+  std::string visitor_state;
+
+  // Writes to a temporary file that then replaces `path`, so that an
+  // interrupted write leaves the previous checkpoint intact. Returns
+  // false on errors.
+  bool Write(const std::string &path) const {
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out << "dlx-checkpoint 1\n" << selected.size();
+      for (int row_idx : selected)
+        out << " " << row_idx;
+      out << "\n" << columns.size() << " " << descend << "\n";
+      for (size_t k = 0; k < columns.size(); k++)
+        out << columns[k] << " " << rows[k] << "\n";
+      out << visitor_state.size() << "\n" << visitor_state;
+      if (!out.flush())
+        return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+  }
+
+  // Returns false if `path` does not hold a checkpoint.
+  bool Read(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int version, nselected, depth;
+    size_t state_size;
+    if (!(in >> magic >> version >> nselected) || magic != "dlx-checkpoint" ||
+        version != 1 || nselected < 0)
+      return false;
+    selected.resize(nselected);
+    for (int &row_idx : selected)
+      in >> row_idx;
+    if (!(in >> depth >> descend) || depth < 0)
+      return false;
+    columns.resize(depth);
+    rows.resize(depth);
+    for (int k = 0; k < depth; k++)
+      in >> columns[k] >> rows[k];
+    if (!(in >> state_size) || in.get() != '\n')
+      return false;
+    visitor_state.resize(state_size);
+    return bool(in.read(&visitor_state[0], state_size));
+  }
+};
+
+// The state of a visitor with checkpoint hooks (see visitor.h), or
+// nothing for visitors without any.
+template <class Visitor> std::string SaveVisitor(const Visitor &visitor) {
+  std::ostringstream out;
+  if constexpr (HasCheckpointHooks<Visitor>::value)
+    visitor.Save(out);
+  return out.str();
+}
+
+template <class Visitor>
+void LoadVisitor(const std::string &state, Visitor &visitor) {
+  if constexpr (HasCheckpointHooks<Visitor>::value) {
+    std::istringstream in(state);
+    visitor.Load(in);
+  }
+}
+
+} // namespace dlx
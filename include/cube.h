@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace dlx {
+
+// One of the subtrees a search is split into by DancingLinks::Cube(..),
+// to be solved on its own, possibly by another process or machine (see
+// DancingLinks::Conquer(..)): the rows to select in a freshly built
+// instance, and which job of the split it is, so that their results
+// can be merged.
+struct CubeJob {
+  int index = 0, count = 1;
+  std::vector<int> rows;
+
+  // Writes to a temporary file that then replaces `path`. Returns false
+  // on errors.
+  bool Write(const std::string &path) const {
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out << "dlx-job 1\n" << index << " " << count << "\n" << rows.size();
+      for (int row_idx : rows)
+        out << " " << row_idx;
+      out << "\n";
+      if (!out.flush())
+        return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+  }
+
+  // Returns false if `path` does not hold a job.
+  bool Read(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    int version, nrows;
+    if (!(in >> magic >> version >> index >> count >> nrows) ||
+        magic != "dlx-job" || version != 1 || index < 0 || index >= count ||
+        nrows < 0)
+      return false;
+    rows.resize(nrows);
+    for (int &row_idx : rows)
+      in >> row_idx;
+    return bool(in);
+  }
+};
+
+// First line of the output of a job, which MergeJobResults(..) reads
+// back. It starts with '|' like the comments of text instances.
+inline std::string JobResultHeader(const CubeJob &job) {
+  return "| job " + std::to_string(job.index) + " of " +
+         std::to_string(job.count) + "\n";
+}
+
+// Merges the outputs of all the jobs of a split, each a header (see
+// JobResultHeader(..)) followed by either a count or solutions one per
+// line, into the output of the whole search: the sum of the counts if
+// `counts`, else the solutions of every job in the order of the jobs.
+// Returns false and sets `error` if an output cannot be read or any
+// job is missing or repeated.
+inline bool MergeJobResults(const std::vector<std::string> &paths,
+                            bool counts, std::ostream &out,
+                            std::string *error) {
+  std::vector<std::string> results; // By job.
+  std::vector<bool> seen;
+  for (const auto &path : paths) {
+    std::ifstream in(path, std::ios::binary);
+    std::string header, bar, job, of;
+    int index, count;
+    if (!std::getline(in, header) ||
+        !(std::istringstream(header) >> bar >> job >> index >> of >> count) ||
+        bar != "|" || job != "job" || of != "of" || index < 0 ||
+        index >= count) {
+      *error = path + ": not the output of a job";
+      return false;
+    }
+    if (results.empty()) {
+      results.resize(count);
+      seen.resize(count);
+    } else if (count != int(results.size())) {
+      *error = path + ": from a split into " + std::to_string(count) +
+               " jobs, not " + std::to_string(results.size());
+      return false;
+    }
+    if (seen[index]) {
+      *error = path + ": job " + std::to_string(index) + " repeated";
+      return false;
+    }
+    seen[index] = true;
+    std::ostringstream body;
+    body << in.rdbuf();
+    results[index] = body.str();
+  }
+  for (size_t index = 0; index < seen.size(); index++) {
+    if (!seen[index]) {
+      *error = "job " + std::to_string(index) + " missing";
+      return false;
+    }
+  }
+  if (results.empty()) {
+    *error = "no jobs";
+    return false;
+  }
+  if (counts) {
+    unsigned long total = 0, count;
+    for (size_t index = 0; index < results.size(); index++) {
+      if (!(std::istringstream(results[index]) >> count)) {
+        *error = "job " + std::to_string(index) + ": no count";
+        return false;
+      }
+      total += count;
+    }
+    out << total << "\n";
+  } else {
+    for (const auto &result : results)
+      out << result;
+  }
+  return bool(out);
+}
+
+} // namespace dlx
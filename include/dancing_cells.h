@@ -0,0 +1,414 @@
+#pragma once
+
+#include "dlx_internal.h"
+#include "matrix.h"
+#include "policies.h"
+#include "stats.h"
+#include "visitor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dlx {
+
+template <class ColumnPickingPolicy, class Index, class StatsPolicy>
+class DancingCells;
+
+// Column picking for DancingCells. The column picking policies read
+// the linked arena of DancingLinks, so each of them is mapped here to
+// the same choice among the active columns of DancingCells, which
+// keeps the search trees of both engines identical. Specialize this
+// template to use another policy with DancingCells.
+template <class ColumnPickingPolicy> struct CellsColumnPicker {
+  static_assert(sizeof(ColumnPickingPolicy) == 0,
+                "Specialize CellsColumnPicker for this policy.");
+};
+
+template <> struct CellsColumnPicker<FirstAvailableColumn> {
+  template <class T> static int ChooseColumn(const T &dc) {
+    int best = -1;
+    for (int k = 0; k < dc.nactive_; k++)
+      if (best == -1 || dc.active_[k] < best)
+        best = dc.active_[k];
+    return best;
+  }
+};
+
+template <> struct CellsColumnPicker<LastAvailableColumn> {
+  template <class T> static int ChooseColumn(const T &dc) {
+    int best = -1;
+    for (int k = 0; k < dc.nactive_; k++)
+      best = std::max(best, dc.active_[k]);
+    return best;
+  }
+};
+
+template <> struct CellsColumnPicker<UniformlyRandomColumn> {
+  template <class T> static int ChooseColumn(const T &dc) {
+    return dc.nactive_ == 0 ? -1 : dc.active_[dc.random_.Below(dc.nactive_)];
+  }
+};
+
+// Fewest ones, ties broken towards the lowest column index like the
+// linked list scan of ColumnWithLeastOnes.
+template <> struct CellsColumnPicker<ColumnWithLeastOnes> {
+  template <class T> static int ChooseColumn(const T &dc) {
+    int best = -1, best_val = std::numeric_limits<int>::max();
+    for (int k = 0; k < dc.nactive_; k++) {
+      int col = dc.active_[k], val = dc.size_[col];
+      if (val < best_val || (val == best_val && col < best)) {
+        best = col;
+        best_val = val;
+      }
+    }
+    return best;
+  }
+};
+
+// The buckets only save scanning linked columns; the scan of the
+// compact array of active columns is cheap enough.
+template <>
+struct CellsColumnPicker<BucketedColumnWithLeastOnes>
+    : CellsColumnPicker<ColumnWithLeastOnes> {};
+
+// Solves the same instances as DancingLinks, with the same visitors
+// and policies, but on "dancing cells" (after Knuth): sparse sets
+// instead of doubly linked lists. The cells of each row are
+// consecutive in one array, and each column keeps the cells of its
+// rows in a block of another array, active ones first. Hiding a row
+// swaps each of its cells (but one) with the last active cell of its
+// column and shrinks the active part, and since the search undoes
+// everything in reverse order, unhiding only grows it back: the
+// swapped cell is still right past the end. Scans thus walk
+// contiguous memory instead of chasing links across the arena, and
+// the active primary columns are kept the same way.
+//
+// Colored columns, multiplicities, ZDDs and the parallel search are
+// specific to DancingLinks (Initialize(..) refuses instances with
+// colors or bounds). Solutions are the same, but may be found
+// in a different order, as the rows of a column get permuted.
+template <class ColumnPickingPolicy = ColumnWithLeastOnes, class Index = int,
+          class StatsPolicy = NoStats>
+class DancingCells {
+  template <class> friend struct CellsColumnPicker;
+  using Picker = CellsColumnPicker<ColumnPickingPolicy>;
+
+public:
+  // Default construction creates a trivial instance.
+  DancingCells() { InitializeColumns(0, 0, 0); }
+
+  // Setup the internal data structures to solve the input instance.
+  DancingCells(MatrixInterface &matrix) { Initialize(matrix); }
+  DancingCells(SparseMatrixInterface &matrix) { Initialize(matrix); }
+
+  // Initialize by probing every entry of a dense matrix. Returns false,
+  // leaving an instance without solutions, if the matrix has bounds or
+  // colors (see IsExactCover(..)).
+  bool Initialize(MatrixInterface &matrix) {
+    if (!IsExactCover(matrix))
+      return Unsupported();
+    InitializeColumns(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    std::vector<std::vector<int>> rows(nrows_);
+    for (int i = 0; i < nrows_; i++)
+      for (int j = 0; j < ncols_; j++)
+        if (matrix.Value(i, j) == 1)
+          rows[i].push_back(j);
+    InitializeCells(
+        [&](int i, std::vector<int> *cols) { *cols = std::move(rows[i]); });
+    return true;
+  }
+
+  // Initialize from a sparse matrix in O(rows + cols + ones). Same
+  // result.
+  bool Initialize(SparseMatrixInterface &matrix) {
+    if (!IsExactCover(matrix))
+      return Unsupported();
+    InitializeColumns(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    InitializeCells(
+        [&](int i, std::vector<int> *cols) { matrix.Row(i, cols); });
+    return true;
+  }
+
+  // See DancingLinks::Solve(..).
+  void Solve(VisitorInterface &visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    (method == SolutionMethod::RECURSIVE) ? RSolve(visitor) : ISolve(visitor);
+  }
+  template <class Visitor>
+  void Solve(Visitor &&visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    (method == SolutionMethod::RECURSIVE) ? RSolve(visitor) : ISolve(visitor);
+  }
+
+  // See DancingLinks::SelectRow(..).
+  bool SelectRow(int row_idx) {
+    assert(0 <= row_idx && row_idx < nrows_);
+    for (Index x = first_[row_idx]; x < first_[row_idx + 1]; x++)
+      if (covered_[cells_[x].col])
+        return false;
+    for (Index x = first_[row_idx]; x < first_[row_idx + 1]; x++)
+      Cover(cells_[x].col);
+    selected_.push_back(row_idx);
+    return true;
+  }
+
+  // See DancingLinks::UnselectRow(..).
+  void UnselectRow() {
+    assert(!selected_.empty());
+    int row_idx = selected_.back();
+    selected_.pop_back();
+    for (Index x = first_[row_idx + 1]; x-- > first_[row_idx];)
+      Uncover(cells_[x].col);
+  }
+
+  void UnselectAllRows() {
+    while (!selected_.empty())
+      UnselectRow();
+  }
+
+  const std::vector<int> &SelectedRows() const { return selected_; }
+
+  // Statistics of the last ISolve(..)/RSolve(..).
+  const StatsPolicy &Stats() const { return stats_; }
+
+  // Seeds the choices of randomized policies (see RandomSource).
+  void Seed(uint32_t seed) { random_.Seed(seed); }
+
+private:
+  // A 1 of the matrix: its column and the position in set_ of the
+  // entry pointing back to it.
+  struct Cell {
+    int col;
+    Index pos;
+  };
+
+  // One level of the search tree: the chosen column and the position
+  // (within the column) of the row currently tried.
+  struct Frame {
+    int col;
+    Index k;
+  };
+
+  // Solve iteratively, on a preallocated stack of frames.
+  template <class Visitor> void ISolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    int depth = 0;
+    bool should_continue = true; // Controls whether to explore new branches.
+    bool descend = true;         // Whether to extend the current branch.
+    while (true) {
+      if (descend) {
+        int col = Picker::ChooseColumn(*this);
+        stats_.Node(depth, col == -1 ? 0 : size_[col]);
+        if (col == -1) { // Found a solution.
+          stats_.Solution();
+          should_continue = VisitChosen(visitor, chosen_);
+        } else if (size_[col] != 0) {
+          Cover(col);
+          frames_[depth++] = {col, 0};
+          ChooseRow(set_[base_[col]]);
+          continue;
+        }
+      }
+      // Backtrack to the deepest level with an untried row.
+      if (depth == 0)
+        break;
+      Frame &f = frames_[depth - 1];
+      UnchooseRow(set_[base_[f.col] + f.k]);
+      descend = should_continue && ++f.k < size_[f.col];
+      if (descend) {
+        ChooseRow(set_[base_[f.col] + f.k]);
+      } else {
+        Uncover(f.col);
+        depth--;
+      }
+    }
+  }
+
+  // Solve recursively.
+  template <class Visitor> void RSolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    RSearch(visitor);
+  }
+
+  // Recursive body of RSolve(..).
+  template <class Visitor> bool RSearch(Visitor &visitor) {
+    int col = Picker::ChooseColumn(*this);
+    stats_.Node(chosen_.size() - selected_.size(), col == -1 ? 0 : size_[col]);
+    if (col == -1) {
+      stats_.Solution();
+      return VisitChosen(visitor, chosen_);
+    }
+    bool should_continue = true;
+    Cover(col);
+    // The rows of a covered column stay put.
+    for (Index k = 0; should_continue && k < size_[col]; k++) {
+      ChooseRow(set_[base_[col] + k]);
+      should_continue = RSearch(visitor);
+      UnchooseRow(set_[base_[col] + k]);
+    }
+    Uncover(col);
+    return should_continue;
+  }
+
+  // Covers the other columns of the row of the cell x, whose column
+  // has been covered already, and records the row.
+  void ChooseRow(Index x) {
+    const int row_idx = row_[x];
+    for (Index y = first_[row_idx]; y < first_[row_idx + 1]; y++)
+      if (y != x)
+        Cover(cells_[y].col);
+    chosen_.push_back(row_idx);
+  }
+
+  // Inverse of ChooseRow(..).
+  void UnchooseRow(Index x) {
+    const int row_idx = row_[x];
+    chosen_.pop_back();
+    for (Index y = first_[row_idx + 1]; y-- > first_[row_idx];)
+      if (y != x)
+        Uncover(cells_[y].col);
+  }
+
+  // Hides the rows of the column and removes it from the active ones.
+  void Cover(int col) {
+    long updates = 1;
+    for (Index k = 0; k < size_[col]; k++)
+      updates += Hide(set_[base_[col] + k]);
+    covered_[col] = true;
+    if (col < sec_col_) { // Swap with the last active primary column.
+      int last = active_[--nactive_], pos = where_[col];
+      active_[pos] = last;
+      where_[last] = pos;
+      active_[nactive_] = col;
+      where_[col] = nactive_;
+    }
+    stats_.Cover(updates);
+  }
+
+  // Inverse of Cover(..).
+  void Uncover(int col) {
+    long updates = 1;
+    if (col < sec_col_)
+      nactive_++;
+    covered_[col] = false;
+    for (Index k = size_[col]; k-- > 0;)
+      updates += Unhide(set_[base_[col] + k]);
+    stats_.Uncover(updates);
+  }
+
+  // Removes the cells of the row of x, but x, from the active part of
+  // their columns. Returns the number of cells removed.
+  long Hide(Index x) {
+    const int row_idx = row_[x];
+    for (Index y = first_[row_idx]; y < first_[row_idx + 1]; y++) {
+      if (y == x)
+        continue;
+      const int col = cells_[y].col;
+      const Index last = base_[col] + --size_[col], pos = cells_[y].pos;
+      const Index z = set_[last];
+      set_[pos] = z;
+      cells_[z].pos = pos;
+      set_[last] = y;
+      cells_[y].pos = last;
+    }
+    return first_[row_idx + 1] - first_[row_idx] - 1;
+  }
+
+  // Inverse of Hide(..).
+  long Unhide(Index x) {
+    const int row_idx = row_[x];
+    for (Index y = first_[row_idx + 1]; y-- > first_[row_idx];)
+      if (y != x)
+        size_[cells_[y].col]++;
+    return first_[row_idx + 1] - first_[row_idx] - 1;
+  }
+
+  // Resets to an instance with the given dimensions and no 1s.
+  void InitializeColumns(int nrows, int ncols, int sec_col) {
+    nrows_ = nrows;
+    ncols_ = ncols;
+    sec_col_ = sec_col;
+    nactive_ = sec_col;
+    active_.resize(sec_col);
+    where_.resize(sec_col);
+    for (int j = 0; j < sec_col; j++)
+      active_[j] = where_[j] = j;
+    base_.assign(ncols + 1, 0);
+    size_.assign(ncols, 0);
+    covered_.assign(ncols, false);
+    first_.assign(1, 0);
+    cells_.clear();
+    row_.clear();
+    set_.clear();
+    selected_.clear();
+    frames_.resize(sec_col);
+    chosen_.reserve(nrows);
+  }
+
+  // Only exact cover instances are supported. Others are replaced by
+  // a single primary column that no row covers.
+  bool Unsupported() {
+    InitializeColumns(0, 1, 1);
+    return false;
+  }
+
+  // Lays out the cells of the rows, given by row(i, &cols), and then
+  // the blocks of the columns in a second pass.
+  template <class RowFn> void InitializeCells(RowFn row) {
+    std::vector<int> cols;
+    for (int i = 0; i < nrows_; i++) {
+      row(i, &cols);
+      for (int j : cols) {
+        assert(0 <= j && j < ncols_);
+        assert(cells_.size() < size_t(std::numeric_limits<Index>::max()));
+        cells_.push_back({j, 0});
+        row_.push_back(i);
+        size_[j]++;
+      }
+      first_.push_back(cells_.size());
+    }
+    for (int j = 0; j < ncols_; j++)
+      base_[j + 1] = base_[j] + size_[j];
+    set_.resize(cells_.size());
+    std::vector<Index> next(base_.begin(), base_.end() - 1);
+    for (Index x = 0; x < Index(cells_.size()); x++) {
+      cells_[x].pos = next[cells_[x].col]++;
+      set_[cells_[x].pos] = x;
+    }
+  }
+
+  // Number of rows and columns of the instance, and the index of the
+  // first secondary column.
+  int nrows_, ncols_, sec_col_;
+  // The cells, row by row: those of row i are first_[i] ..
+  // first_[i + 1] - 1. row_ (cold) holds the row of each cell.
+  std::vector<Cell> cells_;
+  std::vector<Index> first_;
+  std::vector<int> row_;
+  // The block of column j is set_[base_[j]] .. set_[base_[j + 1] - 1],
+  // and its first size_[j] cells are active.
+  std::vector<Index> set_, base_;
+  std::vector<int> size_;
+  // The first nactive_ entries of active_ are the active primary
+  // columns, and where_ is the inverse permutation.
+  std::vector<int> active_, where_;
+  int nactive_;
+  std::vector<char> covered_;
+  // Rows forced into the solution through SelectRow(..), in order.
+  std::vector<int> selected_;
+  // Preallocated search stack of ISolve(..), and the partial solution.
+  std::vector<Frame> frames_;
+  std::vector<int> chosen_;
+  // Observer of the search (see stats.h).
+  StatsPolicy stats_;
+  RandomSource random_;
+};
+
+} // namespace dlx
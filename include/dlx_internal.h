@@ -1,23 +1,100 @@
 #pragma once
 
+#include "arena.h"
 #include "cell.h"
+#include "checkpoint.h"
+#include "cube.h"
+#include "job_pool.h"
 #include "matrix.h"
 #include "policies.h"
+#include "stats.h"
 #include "visitor.h"
+#include "zdd.h"
 
+#include <algorithm>
 #include <cassert>
-#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <iostream>
-#include <stack>
+#include <limits>
+#include <set>
+#include <string>
 #include <thread>
-#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace dlx {
 
 enum class SolutionMethod { RECURSIVE, ITERATIVE };
 
-template <class ColumnPickingPolicy = ColumnWithLeastOnes>
+// Node budgets of the successive runs of DancingLinks::RestartSolve(..),
+// in units: Luby's sequence 1, 1, 2, 1, 1, 2, 4, 1, .. or the powers
+// of two.
+enum class RestartSchedule { LUBY, GEOMETRIC };
+
+// The budget of the run numbered `run` (from 0) under `schedule`.
+inline long RestartBudget(RestartSchedule schedule, int run) {
+  if (schedule == RestartSchedule::GEOMETRIC)
+    return 1L << std::min(run, 62);
+  // Luby: the i-th term (from 1) is 2^(k-1) if i = 2^k - 1, otherwise
+  // the (i - 2^(k-1) + 1)-th term, for the k with 2^(k-1) <= i < 2^k.
+  long i = run + 1;
+  while (true) {
+    int k = 1;
+    while ((1L << k) - 1 < i)
+      k++;
+    if (i == (1L << k) - 1)
+      return 1L << (k - 1);
+    i -= (1L << (k - 1)) - 1;
+  }
+}
+
+// Whether the search of DancingLinks commits the row of every primary
+// column left with a single row right away, without a node of its own
+// (see DancingLinks::SetPropagation(..)).
+enum class Propagation { NONE, SINGLETONS };
+
+// Whether DancingLinks::Reduce(..) keeps rows that duplicate others
+// (in their columns and colors), or merges them into the first one.
+// Merging loses the solutions that differ only in duplicate rows.
+enum class Duplicates { KEEP, MERGE };
+
+// What DancingLinks::Reduce(..) did to an instance.
+struct Reduction {
+  // Rows found to be in every solution, and selected.
+  int forced_rows = 0;
+  // Rows found to be in no solution (or merged duplicates), dropped.
+  int removed_rows = 0;
+  // Columns covered by the forced rows, or dropped as redundant.
+  int removed_columns = 0;
+  // Size of the arena (cells) before and after.
+  size_t cells_before = 0, cells_after = 0;
+  // Whether a primary column was left without rows, in which case
+  // there are no solutions.
+  bool infeasible = false;
+};
+
+// Cells in each column can be numbered consecutively in the arena
+// (COLUMN_MAJOR) instead of in input order (ROW_MAJOR), which keeps
+// the cells visited together while covering a column close in memory.
+enum class CellOrder { ROW_MAJOR, COLUMN_MAJOR };
+
+// The `Index` type holds arena indices and must be able to represent
+// the total number of cells (1 + columns + ones) in the instance. A
+// narrow type like int16_t packs the hot links of small instances
+// into fewer cache lines, while int64_t supports instances with more
+// than 2^31 cells.
+//
+// The *StatsPolicy* (see stats.h) observes the search. The default
+// NoStats compiles to nothing, while SearchStats counts nodes, link
+// updates and more, available through Stats() after solving.
+template <class ColumnPickingPolicy = ColumnWithLeastOnes, class Index = int,
+          class StatsPolicy = NoStats>
 class DancingLinks : public ColumnPickingPolicy {
   // Make all policies friends of this class to avoid bidirectional
   // coupling syntactically (semantically it's unavoidable).
@@ -25,70 +102,188 @@ class DancingLinks : public ColumnPickingPolicy {
 
 public:
   // Default construction creates a trivial instance.
-  DancingLinks() { Reset(); }
+  DancingLinks() {
+    Reset();
+    ColumnPickingPolicy::OnInitialize(*this);
+  }
 
   // Setup the internal data structures to solve the input instance.
   DancingLinks(MatrixInterface &matrix) { Initialize(matrix); }
+  DancingLinks(SparseMatrixInterface &matrix,
+               CellOrder order = CellOrder::ROW_MAJOR) {
+    Initialize(matrix, order);
+  }
 
-  // Initialize the cells according to the initialization policy.
+  // Initialize the cells by probing every entry of a dense matrix.
   void Initialize(MatrixInterface &matrix) {
-    Reset(); // Ensure we are in the default constructed state
-             // before initialization.
-    nrows_ = matrix.Rows();
-    ncols_ = matrix.Cols();
-    O_.resize(ncols_ + 1);
-
-    // Insert all the headers.
-    for (int j = 0; j < ncols_; j++) {
-      C_.emplace_back(Cell{});
-      auto &c = C_.back();
-      c.l = j;
-      c.r = 0;
-      C_[c.l].r = C_[c.r].l = j + 1;
-      c.u = c.d = c.h = j + 1;
-      c.row_idx = -1;
-    }
-
-    // Keep track of the arena index of the bottommost cell in each column.
-    std::vector<int> U;
-    U.resize(ncols_);
-    for (int j = 0; j < ncols_; j++) {
-      U[j] = AIdx(j);
-    }
-
-    // Insert the cells
+    InitializeHeaders(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    InitializeBounds(matrix);
+    std::vector<int> cols, colors;
     for (int i = 0; i < nrows_; i++) {
-      int left = -1, right = -1;
+      cols.clear();
+      colors.clear();
       for (int j = 0; j < ncols_; j++) {
         if (matrix.Value(i, j) == 1) {
-          O_[AIdx(j)]++; // Increment the number of ones in the j-th column.
-          int idx = C_.size();
-          C_.emplace_back(Cell{});
-          auto &c = C_.back();
-          c.h = AIdx(j);
-          c.row_idx = i;
-          if (left == -1) { // First in the row!
-            c.l = c.r = idx;
-            c.u = U[j];
-            c.d = AIdx(j);
-            C_[U[j]].d = C_[AIdx(j)].u = idx;
-          } else {
-            c.l = left;
-            c.r = right;
-            C_[left].r = C_[right].l = idx;
-            c.u = U[j];
-            c.d = AIdx(j);
-            C_[U[j]].d = idx;
-            C_[AIdx(j)].u = idx;
-          }
-          U[j] = left = idx;
-          right = (right == -1) ? idx : right;
+          cols.push_back(j);
+          colors.push_back(matrix.Color(i, j));
         }
       }
+      AppendRow(i, cols, colors, nullptr);
     }
+    FinishColors();
+    ColumnPickingPolicy::OnInitialize(*this);
+  }
 
-    // Save the arena index of the first secondary column.
-    sec_idx_ = AIdx(matrix.FirstSecondaryColumnIndex());
+  // Initialize the cells from a sparse matrix in O(rows + cols + ones).
+  void Initialize(SparseMatrixInterface &matrix,
+                  CellOrder order = CellOrder::ROW_MAJOR) {
+    const size_t ncells = 1 + matrix.Cols() + size_t(matrix.NonZeros());
+    assert(ncells <= size_t(std::numeric_limits<Index>::max()));
+    C_.reserve(ncells); // Exact cell count.
+    I_.reserve(ncells);
+    InitializeHeaders(matrix.Rows(), matrix.Cols(),
+                      matrix.FirstSecondaryColumnIndex());
+    InitializeBounds(matrix);
+    std::vector<int> cols, colors;
+    if (order == CellOrder::ROW_MAJOR) {
+      for (int i = 0; i < nrows_; i++) {
+        matrix.Row(i, &cols);
+        matrix.Colors(i, &colors);
+        AppendRow(i, cols, colors, nullptr);
+      }
+    } else {
+      // Count the ones in each column in a first pass to find the arena
+      // index at which the cells of each column start.
+      for (int i = 0; i < nrows_; i++) {
+        matrix.Row(i, &cols);
+        for (int j : cols)
+          O_[AIdx(j)]++;
+      }
+      std::vector<Index> next(ncols_ + 1);
+      for (int j = 0; j < ncols_; j++)
+        next[AIdx(j)] = (j == 0 ? AIdx(ncols_) : next[j] + O_[j]);
+      std::fill(O_.begin() + 1, O_.end(), 0);
+      C_.resize(ncells);
+      I_.resize(ncells);
+      for (int i = 0; i < nrows_; i++) {
+        matrix.Row(i, &cols);
+        matrix.Colors(i, &colors);
+        AppendRow(i, cols, colors, &next);
+      }
+    }
+    FinishColors();
+    ColumnPickingPolicy::OnInitialize(*this);
+  }
+
+  // Writes the arena of the instance to `path` (see ArenaFileHeader),
+  // for LoadArena(..) to solve it again without building it. The rows
+  // fixed by Reduce(..) are saved with it, but rows selected since
+  // cannot be, so they must be unselected first. Returns false on
+  // errors or if such rows are selected.
+  bool SaveArena(const std::string &path) const {
+    if (selected_.size() > nfixed_)
+      return false;
+    ArenaFileHeader header{};
+    std::memcpy(header.magic, ArenaFileHeader::kMagic, sizeof(header.magic));
+    header.version = ArenaFileHeader::kVersion;
+    header.byte_order = ArenaFileHeader::kByteOrder;
+    header.index_size = sizeof(Index);
+    header.nrows = nrows_;
+    header.ncols = ncols_;
+    header.sec_idx = sec_idx_;
+    const std::pair<const void *, size_t> sections[] = {
+        {C_.begin(), sizeof(C_[0]) * C_.size()},
+        {I_.begin(), sizeof(int) * I_.size()},
+        {K_.begin(), sizeof(int) * K_.size()},
+        {O_.begin(), sizeof(int) * O_.size()},
+        {R_.begin(), sizeof(Index) * R_.size()},
+        {need_.begin(), sizeof(int) * need_.size()},
+        {room_.begin(), sizeof(int) * room_.size()},
+        {selected_.data(), sizeof(int) * selected_.size()}};
+    const size_t lengths[] = {C_.size(),    I_.size(),    K_.size(),
+                              O_.size(),    R_.size(),    need_.size(),
+                              room_.size(), selected_.size()};
+    uint64_t end = sizeof(header);
+    for (int k = 0; k < ArenaFileHeader::NUM_SECTIONS; k++) {
+      end += -end % ArenaFileHeader::kAlignment;
+      header.offset[k] = end;
+      header.length[k] = lengths[k];
+      end += sections[k].second;
+    }
+    const std::string tmp = path + ".tmp";
+    {
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+      const char zeros[ArenaFileHeader::kAlignment] = {};
+      uint64_t pos = sizeof(header);
+      for (int k = 0; k < ArenaFileHeader::NUM_SECTIONS; k++) {
+        out.write(zeros, header.offset[k] - pos);
+        out.write(static_cast<const char *>(sections[k].first),
+                  sections[k].second);
+        pos = header.offset[k] + sections[k].second;
+      }
+      if (!out.flush())
+        return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+  }
+
+  // Solves the instance saved by SaveArena(..) to `path` from then on,
+  // with the rows it had fixed.
+  // The file is mapped into memory and searched in place (pages are
+  // copied as the search first writes them), so loading takes no pass
+  // over the cells, only the O(columns) setup of the policy. Returns
+  // false (and leaves the instance as it was) if `path` is
+  // not an arena file for this Index type and byte order; its contents
+  // are trusted otherwise.
+  bool LoadArena(const std::string &path) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(path) || file->Size() < sizeof(ArenaFileHeader))
+      return false;
+    ArenaFileHeader header;
+    std::memcpy(&header, file->Data(), sizeof(header));
+    if (std::memcmp(header.magic, ArenaFileHeader::kMagic,
+                    sizeof(header.magic)) != 0 ||
+        header.version != ArenaFileHeader::kVersion ||
+        header.byte_order != ArenaFileHeader::kByteOrder ||
+        header.index_size != sizeof(Index))
+      return false;
+    const size_t sizes[] = {sizeof(C_[0]), sizeof(int), sizeof(int),
+                            sizeof(int),   sizeof(Index), sizeof(int),
+                            sizeof(int),   sizeof(int)};
+    for (int k = 0; k < ArenaFileHeader::NUM_SECTIONS; k++) {
+      if (header.offset[k] % ArenaFileHeader::kAlignment != 0 ||
+          header.offset[k] > file->Size() ||
+          header.length[k] > (file->Size() - header.offset[k]) / sizes[k])
+        return false;
+    }
+    Reset();
+    auto section = [&](auto *array, int k) {
+      using T = std::remove_reference_t<decltype((*array)[0])>;
+      array->View(reinterpret_cast<T *>(file->Data() + header.offset[k]),
+                  header.length[k], file);
+    };
+    section(&C_, ArenaFileHeader::CELLS);
+    section(&I_, ArenaFileHeader::ROW_IDS);
+    section(&K_, ArenaFileHeader::COLORS);
+    section(&O_, ArenaFileHeader::COUNTS);
+    section(&R_, ArenaFileHeader::ROWS);
+    section(&need_, ArenaFileHeader::NEED);
+    section(&room_, ArenaFileHeader::ROOM);
+    const int *fixed = reinterpret_cast<const int *>(
+        file->Data() + header.offset[ArenaFileHeader::FIXED]);
+    selected_.assign(fixed, fixed + header.length[ArenaFileHeader::FIXED]);
+    nfixed_ = selected_.size();
+    nrows_ = header.nrows;
+    ncols_ = header.ncols;
+    sec_idx_ = header.sec_idx;
+    frames_.resize(CIdx(sec_idx_));
+    chosen_.reserve(nrows_);
+    if (Multiplicities())
+      excluded_.reserve(nrows_);
+    ColumnPickingPolicy::OnInitialize(*this);
+    return true;
   }
 
   // Print the active state of the board. Each active cell is
@@ -96,10 +291,10 @@ public:
   void PrintBoard() const {
     std::cout << "The active board is " << nrows_ << " x " << ncols_
               << " in size.\n";
-    for (int hdr_idx = C_[0].r; hdr_idx != 0; hdr_idx = C_[hdr_idx].r) {
-      for (int cell_idx = C_[hdr_idx].d; C_[cell_idx].row_idx != -1;
+    for (Index hdr_idx = C_[0].r; hdr_idx != 0; hdr_idx = C_[hdr_idx].r) {
+      for (Index cell_idx = C_[hdr_idx].d; cell_idx != hdr_idx;
            cell_idx = C_[cell_idx].d) {
-        std::cout << "Cell (" << C_[cell_idx].row_idx << ", " << CIdx(hdr_idx)
+        std::cout << "Cell (" << I_[cell_idx] << ", " << CIdx(hdr_idx)
                   << ") at index " << cell_idx << ".\n";
       }
       std::cout << "Column " << CIdx(hdr_idx) << " contains " << O_[hdr_idx]
@@ -107,113 +302,1051 @@ public:
     }
   }
 
-  // Convenience wrapper.
+  // Convenience wrapper. Instances with multiplicities (see
+  // MatrixInterface::Bounds(..)) are always solved by MSolve(..).
   void Solve(VisitorInterface &visitor,
              SolutionMethod method = SolutionMethod::ITERATIVE) {
-    (method == SolutionMethod::RECURSIVE) ? RSolve(visitor) : ISolve(visitor);
+    if (Multiplicities())
+      MSolve(visitor);
+    else
+      (method == SolutionMethod::RECURSIVE) ? RSolve(visitor)
+                                            : ISolve(visitor);
+  }
+
+  // Same as above, but the search is compiled for the given type of
+  // visitor, which may be any implementation of VisitorInterface or a
+  // callable taking the solution (returning whether to continue, or
+  // void to visit all solutions). Callables and final visitor classes
+  // are then called without any virtual dispatch, so that cheap
+  // visitors like CountingVisitor get inlined into the search.
+  template <class Visitor>
+  void Solve(Visitor &&visitor,
+             SolutionMethod method = SolutionMethod::ITERATIVE) {
+    if (Multiplicities())
+      MSolve(visitor);
+    else
+      (method == SolutionMethod::RECURSIVE) ? RSolve(visitor)
+                                            : ISolve(visitor);
+  }
+
+  // Pull based alternative to Solve(..): each call to Next() on the
+  // returned iterator resumes the iterative search up to the next
+  // solution and suspends it again, so solutions can be consumed
+  // lazily and the searches of several instances interleaved on one
+  // thread. Destroying the iterator, exhausted or not, leaves the
+  // instance as it was before. It must not be used otherwise while an
+  // iterator on it is alive.
+  class SolutionIterator;
+  SolutionIterator Solutions() { return SolutionIterator{this}; }
+  // Resumes the search saved by SolutionIterator::Save(..), on an
+  // instance built from the same input and with the same rows
+  // selected.
+  SolutionIterator Solutions(const Checkpoint &checkpoint) {
+    return SolutionIterator{this, &checkpoint};
+  }
+
+  // Searches for a single solution with randomized restarts: each run
+  // descends from scratch and is abandoned after its budget of nodes,
+  // `unit` times the term of `schedule` (see RestartBudget(..)), for
+  // at most `max_runs` runs. With a randomized policy such as
+  // UniformlyRandomColumn every run explores a different tree, which
+  // avoids getting stuck for long in a barren subtree of a single
+  // descent. Visits the solution found, if any, and returns whether
+  // one was found. A run that completes proves there is none.
+  template <class Visitor>
+  bool RestartSolve(Visitor &&visitor, long unit,
+                    RestartSchedule schedule = RestartSchedule::LUBY,
+                    int max_runs = std::numeric_limits<int>::max()) {
+    assert(!Multiplicities()); // Not supported.
+    assert(unit > 0);
+    stats_.Start();
+    for (int run = 0; run < max_runs; run++) {
+      chosen_ = selected_;
+      Cursor cursor;
+      long budget = RestartBudget(schedule, run);
+      cursor.budget = budget > std::numeric_limits<long>::max() / unit
+                          ? std::numeric_limits<long>::max()
+                          : budget * unit;
+      if (NextSolution(&cursor)) {
+        Visit(visitor);
+        AbandonSearch(&cursor);
+        return true;
+      }
+      if (cursor.budget >= 0) // Exhausted.
+        return false;
+      AbandonSearch(&cursor);
+    }
+    return false;
+  }
+
+  // Same as Solve(..) with SolutionMethod::ITERATIVE, for searches
+  // that may be interrupted: every `seconds` the progress is saved to
+  // `path`, along with the state of the visitor (see SaveVisitor(..)),
+  // and a later call finding a checkpoint at `path` resumes from it.
+  // The visitor then sees the solutions after the checkpoint, and its
+  // state is rolled back to that point. The file is removed once the
+  // search completes. The clock is only read every kCheckpointNodes
+  // nodes, which keeps the overhead out of measurements.
+  template <class Visitor>
+  void CheckpointedSolve(Visitor &&visitor, const std::string &path,
+                         double seconds) {
+    assert(!Multiplicities()); // Not supported.
+    stats_.Start();
+    chosen_ = selected_;
+    Cursor cursor;
+    Checkpoint checkpoint;
+    if (checkpoint.Read(path)) {
+      RestoreCursor(checkpoint, &cursor);
+      LoadVisitor(checkpoint.visitor_state, visitor);
+    }
+    auto last = std::chrono::steady_clock::now();
+    cursor.budget = kCheckpointNodes;
+    while (true) {
+      if (NextSolution(&cursor)) {
+        if (!Visit(visitor)) {
+          AbandonSearch(&cursor);
+          break;
+        }
+        continue;
+      }
+      if (cursor.budget >= 0) // Exhausted.
+        break;
+      cursor.budget = kCheckpointNodes;
+      auto now = std::chrono::steady_clock::now();
+      if (std::chrono::duration<double>(now - last).count() >= seconds) {
+        SaveCursor(cursor, &checkpoint);
+        checkpoint.visitor_state = SaveVisitor(visitor);
+        checkpoint.Write(path);
+        last = now;
+      }
+    }
+    std::remove(path.c_str());
+  }
+  static constexpr long kCheckpointNodes = 1 << 16;
+
+  // Forces the row at index `row_idx` (in the input matrix) into every
+  // solution by covering its columns exactly as the search would upon
+  // choosing it. This is cheap compared to rebuilding the instance,
+  // and selected rows are reported at the front of each solution. A
+  // row that conflicts with an already selected row is rejected and
+  // false is returned, leaving the internal state untouched.
+  bool SelectRow(int row_idx) {
+    assert(0 <= row_idx && size_t(row_idx) < R_.size());
+    assert(!Multiplicities()); // Not supported.
+    Index c1_idx = R_[row_idx];
+    if (c1_idx != -1) {
+      Index c2_idx = c1_idx;
+      do {
+        Index hdr_idx = C_[c2_idx].h;
+        if (C_[C_[hdr_idx].r].l != hdr_idx) // Column already covered.
+          return false;
+        if (Colored() && K_[hdr_idx] != 0 && K_[c2_idx] >= 0 &&
+            K_[c2_idx] != K_[hdr_idx]) // Column taken by another color.
+          return false;
+        c2_idx = C_[c2_idx].r;
+      } while (c2_idx != c1_idx);
+      do {
+        Commit(c2_idx);
+        c2_idx = C_[c2_idx].r;
+      } while (c2_idx != c1_idx);
+    }
+    selected_.push_back(row_idx);
+    return true;
+  }
+
+  // Undoes the most recent successful SelectRow(..). Selections must
+  // be undone in LIFO order for the links to be restored correctly.
+  // Rows selected before Reduce(..) can no longer be undone.
+  void UnselectRow() {
+    assert(selected_.size() > nfixed_);
+    Index c1_idx = R_[selected_.back()];
+    selected_.pop_back();
+    if (c1_idx != -1) {
+      Index c2_idx = c1_idx;
+      do {
+        c2_idx = C_[c2_idx].l;
+        Uncommit(c2_idx);
+      } while (c2_idx != c1_idx);
+    }
+  }
+
+  // Undoes all the selections, restoring the instance as initialized
+  // (or as reduced).
+  void UnselectAllRows() {
+    while (selected_.size() > nfixed_)
+      UnselectRow();
+  }
+
+  // Simplifies the instance, with the rows selected so far, before a
+  // search, repeating until nothing changes:
+  // - a primary column with a single row forces it (the row is
+  //   selected, and the rows conflicting with it are dropped);
+  // - if every row of a primary column j has a 1 in column k, the rows
+  //   of k without j are dropped, as they would leave j uncoverable,
+  //   and so is k itself, which no longer constrains anything;
+  // - with Duplicates::MERGE, rows equal to an earlier one are dropped.
+  // The arena is then rebuilt without the dropped rows and columns
+  // (in row major order), and the selected rows become part of the
+  // instance: they start every solution, cannot be unselected, and
+  // are saved by SaveArena(..). Columns with colored 1s are never
+  // dropped as redundant.
+  Reduction Reduce(Duplicates duplicates = Duplicates::KEEP) {
+    assert(!Multiplicities()); // Not supported.
+    Reduction reduction;
+    reduction.cells_before = C_.size();
+    const int nrows = nrows_, ncols = ncols_;
+    const size_t nselected = selected_.size();
+    std::vector<int> stamps(O_.size(), -1);
+    for (bool changed = true; changed && !reduction.infeasible;) {
+      changed = false;
+      // Forced rows.
+      std::vector<Index> singles;
+      for (Index hdr_idx = C_[0].r; hdr_idx != 0 && hdr_idx < sec_idx_;
+           hdr_idx = C_[hdr_idx].r) {
+        if (O_[hdr_idx] == 0)
+          reduction.infeasible = true;
+        else if (O_[hdr_idx] == 1)
+          singles.push_back(hdr_idx);
+      }
+      if (reduction.infeasible)
+        break;
+      for (Index hdr_idx : singles) {
+        if (C_[C_[hdr_idx].r].l != hdr_idx || O_[hdr_idx] != 1)
+          continue; // Covered or emptied by an earlier forced row.
+        [[maybe_unused]] bool selected = SelectRow(I_[C_[hdr_idx].d]);
+        assert(selected);
+        changed = true;
+      }
+      // Dominated columns.
+      for (Index hdr_idx = C_[0].r; hdr_idx != 0 && hdr_idx < sec_idx_;
+           hdr_idx = C_[hdr_idx].r) {
+        if (O_[hdr_idx] == 0)
+          continue;
+        // Columns with a 1 in every row of this one have its stamp.
+        int nrows_seen = 0;
+        for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+             c1_idx = C_[c1_idx].d, nrows_seen++) {
+          for (Index c2_idx = C_[c1_idx].r; c2_idx != c1_idx;
+               c2_idx = C_[c2_idx].r) {
+            const Index k = C_[c2_idx].h;
+            if (Colored() && K_[c2_idx] != 0)
+              continue;
+            if (nrows_seen == 0)
+              stamps[k] = 0;
+            if (stamps[k] == nrows_seen)
+              stamps[k]++;
+          }
+        }
+        for (Index c1_idx = C_[C_[hdr_idx].d].r; c1_idx != C_[hdr_idx].d;
+             c1_idx = C_[c1_idx].r) {
+          const Index k = C_[c1_idx].h;
+          if (stamps[k] != nrows_seen)
+            continue;
+          stamps[k] = -1;
+          if (Colored() && ColumnColored(k))
+            continue;
+          // Drop the rows of k without this column, then k itself.
+          for (Index c2_idx = C_[k].d; c2_idx != k;) {
+            const Index next_idx = C_[c2_idx].d;
+            if (!RowHas(c2_idx, hdr_idx))
+              RemoveRow(c2_idx);
+            c2_idx = next_idx;
+          }
+          DropColumn(k);
+          changed = true;
+        }
+        for (Index c1_idx = C_[C_[hdr_idx].d].r; c1_idx != C_[hdr_idx].d;
+             c1_idx = C_[c1_idx].r)
+          stamps[C_[c1_idx].h] = -1;
+      }
+      // Duplicate rows.
+      if (duplicates == Duplicates::MERGE) {
+        std::unordered_map<std::vector<uint64_t>, int, ColumnSetHash>
+            first_rows;
+        std::vector<uint64_t> key;
+        for (Index hdr_idx = C_[0].r; hdr_idx != 0 && hdr_idx < sec_idx_;
+             hdr_idx = C_[hdr_idx].r) {
+          for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;) {
+            const Index next_idx = C_[c1_idx].d;
+            // Every row is seen first from its leftmost primary column.
+            if (LeftmostPrimary(c1_idx) == c1_idx) {
+              key.clear();
+              Index c2_idx = c1_idx;
+              do {
+                if (!Colored() || K_[c2_idx] >= 0) {
+                  key.push_back(C_[c2_idx].h);
+                  key.push_back(Colored() ? K_[c2_idx] : 0);
+                }
+                c2_idx = C_[c2_idx].r;
+              } while (c2_idx != c1_idx);
+              if (!first_rows.emplace(key, I_[c1_idx]).second) {
+                RemoveRow(c1_idx);
+                changed = true;
+              }
+            }
+            c1_idx = next_idx;
+          }
+        }
+      }
+    }
+    reduction.forced_rows = selected_.size() - nselected;
+    reduction.removed_rows = nrows - nrows_ - reduction.forced_rows;
+    reduction.removed_columns = ncols - ncols_;
+    Rebuild();
+    reduction.cells_after = C_.size();
+    return reduction;
+  }
+
+  // Rows currently forced through SelectRow(..), oldest first.
+  const std::vector<int> &SelectedRows() const { return selected_; }
+
+  // With Propagation::SINGLETONS, ISolve(..) and RSolve(..) (and so
+  // Solutions(), CheckpointedSolve(..) and RestartSolve(..)) follow
+  // each choice of a row by committing the rows of the primary columns
+  // it leaves with a single row, and of those these leave in turn, and
+  // backtrack as soon as it leaves a primary column without rows. The
+  // solutions are the same for fewer nodes, though their rows (and with
+  // policies other than ColumnWithLeastOnes, the solutions themselves)
+  // may come in another order. Other solution methods ignore it.
+  void SetPropagation(Propagation propagation) {
+    propagate_ = propagation == Propagation::SINGLETONS;
+  }
+
+  // Declares a symmetry of the instance: moving each row i to rows[i]
+  // and each column j to columns[j] leaves it unchanged, keeping
+  // primary and secondary columns apart and the colors of the cells,
+  // so that it maps solutions to solutions. Returns false, declaring
+  // nothing, if it does not. Must be called with no rows selected.
+  // Initialize(..) and Reduce(..) drop the declared symmetries.
+  bool AddSymmetry(const std::vector<int> &rows,
+                   const std::vector<int> &columns) {
+    assert(selected_.empty() && !Multiplicities()); // Not supported.
+    const int nrows = R_.size(), ncols = O_.size() - 1;
+    if (int(rows.size()) != nrows || int(columns.size()) != ncols)
+      return false;
+    std::vector<bool> seen_rows(nrows), seen_cols(ncols);
+    for (int i = 0; i < nrows; i++) {
+      if (rows[i] < 0 || rows[i] >= nrows || seen_rows[rows[i]])
+        return false;
+      seen_rows[rows[i]] = true;
+    }
+    for (int j = 0; j < ncols; j++) {
+      if (columns[j] < 0 || columns[j] >= ncols ||
+          seen_cols[columns[j]] ||
+          (j < CIdx(sec_idx_)) != (columns[j] < CIdx(sec_idx_)))
+        return false;
+      seen_cols[columns[j]] = true;
+    }
+    std::vector<std::pair<int, int>> cells, image;
+    for (int i = 0; i < nrows; i++) {
+      RowCells(i, &cells);
+      for (auto &cell : cells)
+        cell.first = columns[cell.first];
+      std::sort(cells.begin(), cells.end());
+      RowCells(rows[i], &image);
+      if (cells != image)
+        return false;
+    }
+    symmetries_.push_back(rows);
+    return true;
+  }
+
+  // Visits one solution of each orbit under the declared symmetries
+  // (see AddSymmetry(..)): the one whose rows, sorted, are the least
+  // lexicographically. Its least row is then the least of its own
+  // orbit, and no row of it has an image below that one, so that the
+  // search runs once for each row m that is the least of its orbit,
+  // with m selected and the rows with an image below m removed, and
+  // the solutions found are checked against their images. Returns the
+  // number of solutions in the orbits visited, each the number of
+  // symmetries over those that fix the solution. The symmetries are
+  // enumerated, so the group they generate should be small (as the 8
+  // of the square). Stats() cover the last of the searches.
+  template <class Visitor> unsigned long SymmetricSolve(Visitor &&visitor) {
+    assert(selected_.empty() && !Multiplicities()); // Not supported.
+    const std::vector<std::vector<int>> group = SymmetryGroup();
+    const int nrows = R_.size();
+    std::vector<int> least(nrows), order(nrows);
+    for (int i = 0; i < nrows; i++) {
+      least[i] = i;
+      for (const auto &g : group)
+        least[i] = std::min(least[i], g[i]);
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [&least](int a, int b) { return least[a] < least[b]; });
+    unsigned long count = 0;
+    bool should_continue = true;
+    std::vector<int> sorted, image;
+    auto leader = [&](const std::vector<int> &solution) {
+      sorted = solution;
+      std::sort(sorted.begin(), sorted.end());
+      unsigned long fixed = 0;
+      for (const auto &g : group) {
+        image.clear();
+        for (int row_idx : sorted)
+          image.push_back(g[row_idx]);
+        std::sort(image.begin(), image.end());
+        if (image < sorted)
+          return true; // Visited through its image.
+        fixed += image == sorted;
+      }
+      count += group.size() / fixed;
+      should_continue = VisitChosen(visitor, solution);
+      return should_continue;
+    };
+    std::vector<Index> removed;
+    int next = 0; // Rows order[0..next) have an image below m.
+    for (int m = 0; m < nrows && should_continue; m++) {
+      if (least[m] != m || R_[m] == -1 || LeftmostPrimary(R_[m]) == -1)
+        continue; // Not the least row of any solution.
+      for (; next < nrows && least[order[next]] < m; next++) {
+        if (R_[order[next]] != -1) {
+          RemoveRow(R_[order[next]]);
+          removed.push_back(R_[order[next]]);
+        }
+      }
+      if (HasEmptyPrimaryColumn())
+        break; // And so for every later m.
+      SelectRow(m);
+      ISolve(leader);
+      UnselectRow();
+    }
+    for (; !removed.empty(); removed.pop_back())
+      RestoreRow(removed.back());
+    return count;
+  }
+
+  // Splits the search into independent jobs ("cube and conquer"), one
+  // for each branch of the search tree still open `depth` levels below
+  // the root, in the order of the search. A job holds the rows selected
+  // so far and those chosen (or forced, see SetPropagation(..)) on its
+  // branch. Branches that end in a solution higher up make jobs too,
+  // and dead ends none, so that the subtrees of the jobs (see
+  // Conquer(..)) hold every solution exactly once.
+  std::vector<CubeJob> Cube(int depth) {
+    assert(!Multiplicities()); // Not supported.
+    std::vector<CubeJob> jobs;
+    chosen_ = selected_;
+    CubeSearch(depth, &jobs);
+    for (auto &job : jobs)
+      job.count = jobs.size();
+    return jobs;
+  }
+
+  // Same as Cube(..) at the least depth that makes at least `njobs`
+  // jobs, or every branch of the tree if it has fewer.
+  std::vector<CubeJob> CubeJobs(size_t njobs) {
+    std::vector<CubeJob> jobs;
+    for (int depth = 0; depth <= CIdx(sec_idx_); depth++) {
+      jobs = Cube(depth);
+      if (jobs.size() >= njobs)
+        break;
+    }
+    return jobs;
+  }
+
+  // Solves the subtree of one of the jobs made by Cube(..) on an
+  // instance built from the same input, with no rows selected: visits
+  // the solutions with all the rows of the job, which come first in
+  // each. Returns false if the rows of the job conflict (which they do
+  // not on the same input), visiting nothing.
+  template <class Visitor>
+  bool Conquer(const CubeJob &job, Visitor &&visitor,
+               SolutionMethod method = SolutionMethod::ITERATIVE) {
+    assert(selected_.empty());
+    for (int row_idx : job.rows) {
+      if (row_idx < 0 || size_t(row_idx) >= R_.size() || !SelectRow(row_idx)) {
+        UnselectAllRows();
+        return false;
+      }
+    }
+    Solve(visitor, method);
+    UnselectAllRows();
+    return true;
+  }
+
+  // Statistics of the last ISolve(..)/RSolve(..).
+  const StatsPolicy &Stats() const { return stats_; }
+
+  // Builds a ZDD of all the solutions (Knuth's Algorithm DXZ) in `zdd`
+  // and returns its root. Subproblems are identified by their set of
+  // active columns and solved only once, so the time is proportional
+  // to the number of distinct subproblems rather than the number of
+  // solutions. Count, enumerate or sample the solutions through `zdd`.
+  int ZddSolve(Zdd *zdd) {
+    assert(!Multiplicities()); // Not supported.
+    std::unordered_map<std::vector<uint64_t>, int, ColumnSetHash> memo;
+    std::vector<uint64_t> key;
+    zdd->SetPrefix(selected_);
+    const bool propagate = std::exchange(propagate_, false);
+    const int root = ZSolve(zdd, &memo, &key);
+    propagate_ = propagate;
+    return root;
+  }
+
+  // Solve on visitors.size() threads. Every worker searches a private
+  // copy of this instance and reports its solutions to its own visitor
+  // (pass the same thread-safe visitor repeatedly to share one), so
+  // per-thread results like counts need to be combined by the caller.
+  // The tree is split among the workers on demand: whenever a worker
+  // runs out of work, busy workers hand off the untried branches at
+  // their shallowest open level. Solutions are visited in no
+  // particular order, and all workers stop once any visitor returns
+  // false.
+  void ParallelSolve(const std::vector<VisitorInterface *> &visitors) {
+    assert(!Multiplicities()); // Not supported.
+    JobPool pool(visitors.size());
+    pool.Push(0, {});
+    std::vector<std::thread> threads;
+    for (int worker = 0; worker < int(visitors.size()); worker++) {
+      threads.emplace_back([this, &pool, &visitors, worker]() {
+        DancingLinks copy{*this};
+        copy.propagate_ = false;
+        copy.PSolve(worker, pool, *visitors[worker]);
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
   }
 
   /////////////////////
   // Private methods //
   /////////////////////
 private:
+  // Reports the current solution to the visitor (see VisitChosen(..)).
+  template <class Visitor> bool Visit(Visitor &visitor) {
+    return VisitChosen(visitor, chosen_);
+  }
+
+  // One level of the search tree: the chosen column, the cell of the
+  // row currently tried, and (for ParallelSolve(..)) whether the
+  // untried rows have been handed off to other workers.
+  struct Frame {
+    Index hdr_idx, c1_idx;
+    bool split;
+    size_t trail; // Size of trail_ before the row was chosen.
+  };
+
+  // Position of a suspended ISolve(..): the depth of the current
+  // branch (the frames above it are in frames_) and whether to extend
+  // it or move on to the next branch. The search also pauses before
+  // the node at which the budget of nodes runs out, leaving it at -1
+  // (a negative budget never runs out).
+  struct Cursor {
+    int depth = 0;
+    bool descend = true;
+    long budget = -2;
+  };
+
   // Solve iteratively. The supplied `visitor` allows the backtracking
   // to end prematurely (before visiting all solutions). Even in the
   // case of a premature exit, the internal state after the call is
   // left identical to the one before the call to ISolve(..) relieving
   // callers of any kind of bookkeeping.
-  void ISolve(VisitorInterface &visitor) {
-    // Stores the state at which context on the stack should be
-    // interpreted.
-    enum class State {
-      FIND_COLUMN,
-      UNCOVER_COLUMN,
-      CHOOSE_ROW,
-      UNCHOOSE_ROW,
-    };
+  //
+  // Every level of the tree covers at least one primary column, so a
+  // stack of frames preallocated for that depth suffices. Each frame
+  // keeps only the row currently tried, the next sibling being one
+  // down link away, and no memory is allocated during the search.
+  template <class Visitor> void ISolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    Cursor cursor;
+    while (NextSolution(&cursor)) {
+      if (!Visit(visitor)) {
+        AbandonSearch(&cursor);
+        break;
+      }
+    }
+  }
 
-    // Store the hdr_idx, c1_idx pair along with the state.
-    std::stack<std::tuple<int, int, State>> s{{{-1, -1, State::FIND_COLUMN}}};
-    std::vector<int> chosen;
-    bool should_continue = true; // Controls whether to explore new branches.
-    while (!s.empty()) {
-      int hdr_idx = std::get<0>(s.top()), c1_idx = std::get<1>(s.top());
-      State state = std::get<2>(s.top());
-      s.pop();
-
-      // Figure out what to do.
-      if (should_continue && state == State::FIND_COLUMN) {
-        hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+  // Runs the iterative search from `cursor` up to its next solution,
+  // returning true with the solution in chosen_ and the arena as at
+  // that leaf, or false once the tree is exhausted and the arena is
+  // restored. The search is thus suspended between solutions.
+  bool NextSolution(Cursor *cursor) {
+    int &depth = cursor->depth;
+    while (true) {
+      if (cursor->descend) {
+        if (cursor->budget-- == 0)
+          return false;
+        Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+        stats_.Node(depth, hdr_idx == -1 ? 0 : O_[hdr_idx]);
         if (hdr_idx == -1) { // Found a solution.
-          should_continue = visitor.VisitSolution(chosen);
-          continue;
-        }
-        if (C_[hdr_idx].d == hdr_idx) { // No solution.
+          stats_.Solution();
+          cursor->descend = false;
+          return true;
+        } else if (C_[hdr_idx].d != hdr_idx) {
+          Cover(hdr_idx);
+          frames_[depth++] = {hdr_idx, C_[hdr_idx].d, false, trail_.size()};
+          ChooseRow(C_[hdr_idx].d, &chosen_);
+          cursor->descend = !propagate_ || Propagate();
           continue;
         }
-        Cover(hdr_idx);
-        s.push({hdr_idx, -1, State::UNCOVER_COLUMN});
-        for (int c1_idx = C_[hdr_idx].u; C_[c1_idx].row_idx != -1;
-             c1_idx = C_[c1_idx].u) {
-          s.push({hdr_idx, c1_idx, State::CHOOSE_ROW});
-        }
-      } else if (should_continue && state == State::CHOOSE_ROW) {
-        for (int c2_idx = C_[c1_idx].r; C_[c2_idx].h != hdr_idx;
-             c2_idx = C_[c2_idx].r) {
-          Cover(C_[c2_idx].h);
-        }
-        chosen.push_back(C_[c1_idx].row_idx);
-        s.push({hdr_idx, c1_idx, State::UNCHOOSE_ROW});
-        s.push({-1, -1, State::FIND_COLUMN});
-      } else if (state == State::UNCHOOSE_ROW) {
-        chosen.pop_back();
-        for (int c2_idx = C_[c1_idx].l; C_[c2_idx].h != hdr_idx;
-             c2_idx = C_[c2_idx].l) {
-          Uncover(C_[c2_idx].h);
-        }
-      } else if (state == State::UNCOVER_COLUMN) {
-        Uncover(hdr_idx);
+      }
+      // Backtrack to the deepest level with an untried row.
+      if (depth == 0) {
+        cursor->descend = false; // For good.
+        return false;
+      }
+      Frame &f = frames_[depth - 1];
+      Unpropagate(f.trail);
+      UnchooseRow(f.c1_idx, &chosen_);
+      f.c1_idx = C_[f.c1_idx].d;
+      cursor->descend = f.c1_idx != f.hdr_idx;
+      if (cursor->descend) {
+        ChooseRow(f.c1_idx, &chosen_);
+        cursor->descend = !propagate_ || Propagate();
+      } else {
+        Uncover(f.hdr_idx);
+        depth--;
       }
     }
   }
 
-  // Solve recursively. Comment preceding ISolve(..) applies here too.
-  void RSolve(VisitorInterface &visitor) {
-    std::vector<int> chosen;
-    std::function<bool(std::vector<int> &, VisitorInterface &)> recursive_solve;
-    recursive_solve = [&](std::vector<int> &chosen,
-                          VisitorInterface &visitor) -> bool {
-      int hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
-      if (hdr_idx == -1) {
-        return visitor.VisitSolution(chosen);
-      }
-      if (C_[hdr_idx].d == hdr_idx) {
-        return true;
+  // Saves the position of a suspended search in terms of the input.
+  void SaveCursor(const Cursor &cursor, Checkpoint *checkpoint) const {
+    checkpoint->selected = selected_;
+    checkpoint->columns.clear();
+    checkpoint->rows.clear();
+    for (int level = 0; level < cursor.depth; level++) {
+      checkpoint->columns.push_back(CIdx(frames_[level].hdr_idx));
+      checkpoint->rows.push_back(I_[frames_[level].c1_idx]);
+      // Then the rows propagation forced after it, as levels of their
+      // own, which hold no other rows to try.
+      const size_t end = level + 1 < cursor.depth ? frames_[level + 1].trail
+                                                  : trail_.size();
+      for (size_t t = frames_[level].trail; t < end; t++) {
+        checkpoint->columns.push_back(CIdx(C_[trail_[t]].h));
+        checkpoint->rows.push_back(I_[trail_[t]]);
       }
+    }
+    checkpoint->descend = cursor.descend;
+  }
 
-      // Cover the chosen column.
+  // Inverse of SaveCursor(..): redoes the covers of the saved branch,
+  // which leaves every column in the same order as when it was saved.
+  void RestoreCursor(const Checkpoint &checkpoint, Cursor *cursor) {
+    assert(checkpoint.selected == selected_);
+    assert(cursor->depth == 0);
+    for (size_t level = 0; level < checkpoint.columns.size(); level++) {
+      assert(0 <= checkpoint.columns[level] &&
+             checkpoint.columns[level] < sec_idx_ - 1);
+      Index hdr_idx = AIdx(checkpoint.columns[level]);
       Cover(hdr_idx);
-      bool should_continue = true; // Controls whether to explore new branches.
-      // Otherwise, pick a row and add it to the tentative solution.
-      for (int c1_idx = C_[hdr_idx].d;
-           should_continue && C_[c1_idx].row_idx != -1; c1_idx = C_[c1_idx].d) {
-        for (int c2_idx = C_[c1_idx].r; C_[c2_idx].h != hdr_idx;
-             c2_idx = C_[c2_idx].r) {
-          Cover(C_[c2_idx].h);
+      Index c1_idx = C_[hdr_idx].d;
+      while (c1_idx != hdr_idx && I_[c1_idx] != checkpoint.rows[level])
+        c1_idx = C_[c1_idx].d;
+      assert(c1_idx != hdr_idx); // The row must still be there.
+      frames_[cursor->depth++] = {hdr_idx, c1_idx, false, trail_.size()};
+      ChooseRow(c1_idx, &chosen_);
+    }
+    units_.clear();
+    cursor->descend = checkpoint.descend;
+  }
+
+  // Unwinds a suspended search without exploring it any further.
+  void AbandonSearch(Cursor *cursor) {
+    for (; cursor->depth > 0; cursor->depth--) {
+      Frame &f = frames_[cursor->depth - 1];
+      Unpropagate(f.trail);
+      UnchooseRow(f.c1_idx, &chosen_);
+      Uncover(f.hdr_idx);
+    }
+  }
+
+  // Recursive body of Cube(..).
+  void CubeSearch(int depth, std::vector<CubeJob> *jobs) {
+    Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+    if (hdr_idx != -1 && C_[hdr_idx].d == hdr_idx)
+      return; // Dead end.
+    if (hdr_idx == -1 || depth == 0) {
+      jobs->emplace_back();
+      jobs->back().index = jobs->size() - 1;
+      jobs->back().rows = chosen_;
+      return;
+    }
+    Cover(hdr_idx);
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      ChooseRow(c1_idx, &chosen_);
+      const size_t trail = trail_.size();
+      if (!propagate_ || Propagate())
+        CubeSearch(depth - 1, jobs);
+      Unpropagate(trail);
+      UnchooseRow(c1_idx, &chosen_);
+    }
+    Uncover(hdr_idx);
+  }
+
+  // Solve recursively. Comment preceding ISolve(..) applies here too.
+  template <class Visitor> void RSolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    RSearch(visitor, 0);
+  }
+
+  // Recursive body of RSolve(..), `depth` branching choices deep like
+  // the frames of ISolve(..): rows committed by Propagate(..) do not
+  // count.
+  template <class Visitor> bool RSearch(Visitor &visitor, int depth) {
+    Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+    stats_.Node(depth, hdr_idx == -1 ? 0 : O_[hdr_idx]);
+    if (hdr_idx == -1) {
+      stats_.Solution();
+      return Visit(visitor);
+    }
+    if (C_[hdr_idx].d == hdr_idx) {
+      return true;
+    }
+
+    // Cover the chosen column.
+    Cover(hdr_idx);
+    bool should_continue = true; // Controls whether to explore new branches.
+    // Otherwise, pick a row and add it to the tentative solution.
+    for (Index c1_idx = C_[hdr_idx].d; should_continue && c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      ChooseRow(c1_idx, &chosen_);
+      const size_t trail = trail_.size();
+      if (!propagate_ || Propagate())
+        should_continue = RSearch(visitor, depth + 1);
+      Unpropagate(trail);
+      UnchooseRow(c1_idx, &chosen_);
+    }
+    // Uncover the chosen column.
+    Uncover(hdr_idx);
+    return should_continue;
+  }
+
+  // Solve an instance with multiplicities, in the spirit of Knuth's
+  // Algorithm M. Each node picks an open primary column (one that may
+  // take more rows) and tries each of its rows in turn. A row that has
+  // been tried is then excluded from the following branches of the
+  // node, so the k-th branch finds the solutions whose next row in the
+  // column is its k-th one, and no solution is visited twice. Once the
+  // column has enough rows, a last branch closes it (covers it) to
+  // find the solutions without any more of its rows. A column is also
+  // covered as soon as it is full. The search is recursive, whatever
+  // the SolutionMethod.
+  template <class Visitor> void MSolve(Visitor &visitor) {
+    stats_.Start();
+    chosen_ = selected_;
+    excluded_.clear();
+    const bool propagate = std::exchange(propagate_, false);
+    MSearch(visitor, 0);
+    propagate_ = propagate;
+  }
+
+  // Recursive body of MSolve(..), `depth` branches deep.
+  template <class Visitor> bool MSearch(Visitor &visitor, int depth) {
+    Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+    stats_.Node(depth, hdr_idx == -1 ? 0 : std::max(0, Branching(hdr_idx)));
+    if (hdr_idx == -1) {
+      stats_.Solution();
+      return Visit(visitor);
+    }
+    bool should_continue = true;
+    const size_t excluded = excluded_.size();
+    // Stop as soon as too few rows are left to cover the column.
+    for (Index c1_idx = C_[hdr_idx].d; should_continue && c1_idx != hdr_idx &&
+                                       O_[hdr_idx] >= need_[hdr_idx];
+         c1_idx = C_[c1_idx].d) {
+      MChooseRow(c1_idx);
+      should_continue = MSearch(visitor, depth + 1);
+      MUnchooseRow(c1_idx);
+      RemoveRow(c1_idx);
+      excluded_.push_back(c1_idx);
+    }
+    if (should_continue && need_[hdr_idx] <= 0) {
+      Cover(hdr_idx);
+      should_continue = MSearch(visitor, depth + 1);
+      Uncover(hdr_idx);
+    }
+    while (excluded_.size() > excluded) {
+      RestoreRow(excluded_.back());
+      excluded_.pop_back();
+    }
+    return should_continue;
+  }
+
+  struct ColumnSetHash {
+    size_t operator()(const std::vector<uint64_t> &key) const {
+      uint64_t h = 0xcbf29ce484222325ULL;
+      for (uint64_t word : key)
+        h = (h ^ word) * 0x100000001b3ULL;
+      return h;
+    }
+  };
+
+  // Recursive body of ZddSolve(..). `key` is scratch space for the
+  // bitmask of the active columns.
+  int ZSolve(Zdd *zdd,
+             std::unordered_map<std::vector<uint64_t>, int, ColumnSetHash> *memo,
+             std::vector<uint64_t> *key) {
+    Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+    if (hdr_idx == -1)
+      return Zdd::kUnit;
+    if (C_[hdr_idx].d == hdr_idx)
+      return Zdd::kEmpty;
+    key->assign((O_.size() + 63) / 64, 0);
+    for (Index idx = C_[0].r; idx != 0; idx = C_[idx].r)
+      (*key)[idx / 64] |= uint64_t(1) << (idx % 64);
+    if (Colored()) { // Colors taken by the active secondary columns.
+      for (Index idx = C_[0].r; idx != 0; idx = C_[idx].r)
+        if (idx >= sec_idx_)
+          key->push_back(K_[idx]);
+    }
+    auto it = memo->find(*key);
+    if (it != memo->end())
+      return it->second;
+    std::vector<uint64_t> subproblem(*key);
+
+    // Chain the solutions through each row of the chosen column.
+    int root = Zdd::kEmpty;
+    Cover(hdr_idx);
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      for (Index c2_idx = C_[c1_idx].r; c2_idx != c1_idx;
+           c2_idx = C_[c2_idx].r)
+        Commit(c2_idx);
+      int hi = ZSolve(zdd, memo, key);
+      for (Index c2_idx = C_[c1_idx].l; c2_idx != c1_idx;
+           c2_idx = C_[c2_idx].l)
+        Uncommit(c2_idx);
+      root = zdd->Node(I_[c1_idx], root, hi);
+    }
+    Uncover(hdr_idx);
+    return (*memo)[std::move(subproblem)] = root;
+  }
+
+  // Body of a ParallelSolve(..) worker running on its private copy.
+  void PSolve(int worker, JobPool &pool, VisitorInterface &visitor) {
+    std::vector<Frame> frames;
+    std::vector<int> job, chosen;
+    const int base = selected_.size();
+    while (pool.Pop(worker, &job)) {
+      for (int row_idx : job) {
+        bool selected = SelectRow(row_idx);
+        assert(selected);
+      }
+      chosen = selected_;
+      bool descend = true;
+      while (true) {
+        if (descend && !pool.Stopped()) {
+          Index hdr_idx = ColumnPickingPolicy::ChooseColumn(*this);
+          if (hdr_idx == -1) { // Found a solution.
+            if (!visitor.VisitSolution(chosen))
+              pool.Stop();
+          } else if (C_[hdr_idx].d != hdr_idx) {
+            Cover(hdr_idx);
+            frames.push_back({hdr_idx, C_[hdr_idx].d, false, 0});
+            ChooseRow(frames.back().c1_idx, &chosen);
+            continue;
+          }
         }
-        chosen.push_back(C_[c1_idx].row_idx);
-        should_continue = recursive_solve(chosen, visitor);
-        chosen.pop_back();
-        for (int c2_idx = C_[c1_idx].l; C_[c2_idx].h != hdr_idx;
-             c2_idx = C_[c2_idx].l) {
-          Uncover(C_[c2_idx].h);
+        // Backtrack to the deepest level with an untried row.
+        if (frames.empty())
+          break;
+        auto &f = frames.back();
+        UnchooseRow(f.c1_idx, &chosen);
+        f.c1_idx = C_[f.c1_idx].d;
+        if (f.split || f.c1_idx == f.hdr_idx || pool.Stopped()) {
+          Uncover(f.hdr_idx);
+          frames.pop_back();
+          descend = false;
+          continue;
         }
+        ChooseRow(f.c1_idx, &chosen);
+        descend = true;
+
+        // Share the untried rows of the shallowest open level.
+        if (pool.Hungry()) {
+          for (size_t level = 0; level < frames.size(); level++) {
+            auto &g = frames[level];
+            if (g.split || C_[g.c1_idx].d == g.hdr_idx)
+              continue;
+            for (Index c1_idx = C_[g.c1_idx].d; c1_idx != g.hdr_idx;
+                 c1_idx = C_[c1_idx].d) {
+              std::vector<int> prefix(chosen.begin() + base,
+                                      chosen.begin() + job.size() + base +
+                                          level);
+              prefix.push_back(I_[c1_idx]);
+              pool.Push(worker, std::move(prefix));
+            }
+            g.split = true;
+            break;
+          }
+        }
+      }
+      for (size_t k = 0; k < job.size(); k++)
+        UnselectRow();
+      pool.Done();
+    }
+  }
+
+  // Commits the remaining columns of the row containing the cell
+  // c1_idx whose column has been covered already, and records the row.
+  void ChooseRow(Index c1_idx, std::vector<int> *chosen) {
+    for (Index c2_idx = C_[c1_idx].r; c2_idx != c1_idx; c2_idx = C_[c2_idx].r)
+      Commit(c2_idx);
+    chosen->push_back(I_[c1_idx]);
+  }
+
+  // Inverse of ChooseRow(..).
+  void UnchooseRow(Index c1_idx, std::vector<int> *chosen) {
+    chosen->pop_back();
+    for (Index c2_idx = C_[c1_idx].l; c2_idx != c1_idx; c2_idx = C_[c2_idx].l)
+      Uncommit(c2_idx);
+  }
+
+  // Claims the column of the cell c2_idx for its (chosen) row: covers
+  // the column if the cell is uncolored, or purifies it if the cell is
+  // colored. A cell whose color the column already has needs nothing.
+  void Commit(Index c2_idx) {
+    if (!Colored() || K_[c2_idx] == 0)
+      Cover(C_[c2_idx].h);
+    else if (K_[c2_idx] > 0)
+      Purify(c2_idx);
+  }
+
+  // Inverse of Commit(..).
+  void Uncommit(Index c2_idx) {
+    if (!Colored() || K_[c2_idx] == 0)
+      Uncover(C_[c2_idx].h);
+    else if (K_[c2_idx] > 0)
+      Unpurify(c2_idx);
+  }
+
+  // Gives the column of the colored cell p_idx the cell's color: rows
+  // of other colors are hidden, while the other cells of the same
+  // color are marked (color -1) so that hiding their rows later leaves
+  // them in the column, and committing them is a no-op.
+  void Purify(Index p_idx) {
+    const int color = K_[p_idx];
+    const Index hdr_idx = C_[p_idx].h;
+    long updates = 0;
+    K_[hdr_idx] = color;
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      if (K_[c1_idx] == color) {
+        if (c1_idx != p_idx)
+          K_[c1_idx] = -1;
+      } else {
+        updates += Hide(c1_idx);
+        nrows_--;
+      }
+    }
+    stats_.Cover(updates);
+  }
+
+  // Inverse of Purify(..).
+  void Unpurify(Index p_idx) {
+    const int color = K_[p_idx];
+    const Index hdr_idx = C_[p_idx].h;
+    long updates = 0;
+    for (Index c1_idx = C_[hdr_idx].u; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].u) {
+      if (K_[c1_idx] < 0) {
+        K_[c1_idx] = color;
+      } else if (c1_idx != p_idx) {
+        nrows_++;
+        updates += Unhide(c1_idx);
       }
-      // Uncover the chosen column.
+    }
+    K_[hdr_idx] = 0;
+    stats_.Uncover(updates);
+  }
+
+  // Whether any 1 of the instance is colored.
+  inline bool Colored() const { return !K_.empty(); }
+
+  // Whether any primary column has bounds other than exactly once.
+  inline bool Multiplicities() const { return !need_.empty(); }
+
+  // Number of branches MSolve(..) could take on the active primary
+  // column hdr_idx: its rows, but for those that must be left for the
+  // rows it still needs, plus closing it if it needs none. That is its
+  // number of ones for exact cover, and zero or less means that the
+  // current branch fails.
+  inline int Branching(Index hdr_idx) const {
+    return Multiplicities() ? O_[hdr_idx] + 1 - std::max(need_[hdr_idx], 0)
+                            : O_[hdr_idx];
+  }
+
+  // Chooses the row containing the cell c1_idx in MSolve(..): the row
+  // is removed from all its columns, and each column is taken once.
+  void MChooseRow(Index c1_idx) {
+    RemoveRow(c1_idx);
+    Index c2_idx = c1_idx;
+    do {
+      Take(c2_idx);
+      c2_idx = C_[c2_idx].r;
+    } while (c2_idx != c1_idx);
+    chosen_.push_back(I_[c1_idx]);
+  }
+
+  // Inverse of MChooseRow(..).
+  void MUnchooseRow(Index c1_idx) {
+    chosen_.pop_back();
+    Index c2_idx = c1_idx;
+    do {
+      c2_idx = C_[c2_idx].l;
+      Untake(c2_idx);
+    } while (c2_idx != c1_idx);
+    RestoreRow(c1_idx);
+  }
+
+  // Accounts for one more row covering the column of the cell c2_idx,
+  // covering it if it is full. Secondary columns are committed as
+  // usual.
+  void Take(Index c2_idx) {
+    const Index hdr_idx = C_[c2_idx].h;
+    if (hdr_idx >= sec_idx_) {
+      Commit(c2_idx);
+      return;
+    }
+    need_[hdr_idx]--;
+    if (--room_[hdr_idx] == 0)
+      Cover(hdr_idx);
+    else
+      ColumnPickingPolicy::OnCountChange(*this, hdr_idx);
+  }
+
+  // Inverse of Take(..).
+  void Untake(Index c2_idx) {
+    const Index hdr_idx = C_[c2_idx].h;
+    if (hdr_idx >= sec_idx_) {
+      Uncommit(c2_idx);
+      return;
+    }
+    need_[hdr_idx]++;
+    if (room_[hdr_idx]++ == 0)
       Uncover(hdr_idx);
-      return should_continue;
-    };
-    recursive_solve(chosen, visitor);
+    else
+      ColumnPickingPolicy::OnCountChange(*this, hdr_idx);
+  }
+
+  // Unlinks every cell of the row containing c1_idx from its column.
+  void RemoveRow(Index c1_idx) {
+    Hide(c1_idx);
+    auto &c = C_[c1_idx];
+    C_[c.u].d = c.d;
+    C_[c.d].u = c.u;
+    O_[c.h]--;
+    ColumnPickingPolicy::OnCountChange(*this, c.h);
+    nrows_--;
+  }
+
+  // Inverse of RemoveRow(..).
+  void RestoreRow(Index c1_idx) {
+    nrows_++;
+    auto &c = C_[c1_idx];
+    O_[c.h]++;
+    ColumnPickingPolicy::OnCountChange(*this, c.h);
+    C_[c.d].u = c1_idx;
+    C_[c.u].d = c1_idx;
+    Unhide(c1_idx);
   }
 
   // Reverts to default constructed state. There is no reason for this
@@ -224,58 +1357,401 @@ private:
     // Create the sentinel header cell.
     C_.resize(1);
     C_[0].l = C_[0].r = C_[0].u = C_[0].d = C_[0].h = 0;
-    C_[0].row_idx = -1;
+    I_.assign(1, -1);
+    K_.clear();
+    need_.clear();
+    room_.clear();
     O_.resize(1);
     O_[0] = 1;
 
     // Make an instance with zero rows and zero columns.
     nrows_ = ncols_ = 0;
     sec_idx_ = 1;
+    R_.clear();
+    selected_.clear();
+    nfixed_ = 0;
+    units_.clear();
+    trail_.clear();
+    symmetries_.clear();
+    frames_.clear();
   }
 
   // Arena index of the j-th column.
-  inline int AIdx(int j) const { return j + 1; }
+  inline Index AIdx(int j) const { return j + 1; }
 
   // Inverse of AIdx(..): Get a column index from the arena index of
   // some header cell.
-  inline int CIdx(int hdr_idx) const { return hdr_idx - 1; }
+  inline int CIdx(Index hdr_idx) const { return hdr_idx - 1; }
 
-  // Covers the column whose arena index is specified.
-  void Cover(int hdr_idx) {
-    for (int c1_idx = C_[hdr_idx].d; C_[c1_idx].row_idx != -1;
+  // Resets the arena and inserts the headers of an instance with the
+  // given dimensions. Rows are added afterwards through AppendRow(..).
+  void InitializeHeaders(int nrows, int ncols, int sec_col) {
+    Reset(); // Ensure we are in the default constructed state
+             // before initialization.
+    nrows_ = nrows;
+    ncols_ = ncols;
+    O_.resize(ncols_ + 1);
+    R_.assign(nrows_, -1);
+    C_.reserve(ncols_ + 1);
+    for (int j = 0; j < ncols_; j++) {
+      C_.emplace_back(Cell<Index>{});
+      I_.push_back(-1);
+      auto &c = C_.back();
+      c.l = j;
+      c.r = 0;
+      C_[c.l].r = C_[c.r].l = j + 1;
+      c.u = c.d = c.h = j + 1;
+    }
+    // Save the arena index of the first secondary column.
+    sec_idx_ = AIdx(sec_col);
+    frames_.resize(sec_col);
+    chosen_.reserve(nrows_);
+  }
+
+  // Reads the bounds of the primary columns. Unless they are all 1 and
+  // 1, sets up the multiplicities for MSolve(..). Columns that take no
+  // rows start out covered, and their rows are left out by
+  // AppendRow(..), so this comes after the headers and before the
+  // rows.
+  void InitializeBounds(MatrixInterface &matrix) {
+    for (int j = 0; j < CIdx(sec_idx_); j++) {
+      int lo, hi;
+      matrix.Bounds(j, &lo, &hi);
+      assert(0 <= lo && lo <= hi);
+      if (lo == 1 && hi == 1 && !Multiplicities())
+        continue;
+      if (!Multiplicities()) {
+        need_.assign(ncols_ + 1, 0);
+        room_.assign(ncols_ + 1, 0);
+        for (int k = 0; k < j; k++)
+          need_[AIdx(k)] = room_[AIdx(k)] = 1;
+        excluded_.reserve(nrows_);
+      }
+      need_[AIdx(j)] = lo;
+      room_[AIdx(j)] = hi;
+      if (hi == 0) {
+        C_[C_[AIdx(j)].l].r = C_[AIdx(j)].r;
+        C_[C_[AIdx(j)].r].l = C_[AIdx(j)].l;
+        ncols_--;
+      }
+    }
+  }
+
+  // Links the 1s of the i-th row (given by their column indices) at
+  // the bottom of their columns. The header's up link always points
+  // to the bottommost cell of the column, so no extra bookkeeping is
+  // necessary while the rows are appended in order. The cells are
+  // appended to the arena, unless `next` holds the (preallocated)
+  // arena index at which to place the next cell of each column.
+  // `colors` is either empty or parallel to `cols`.
+  void AppendRow(int i, const std::vector<int> &cols,
+                 const std::vector<int> &colors, std::vector<Index> *next) {
+    assert(colors.empty() || colors.size() == cols.size());
+    if (Multiplicities()) { // Rows in columns with hi = 0 are left out.
+      for (int j : cols)
+        if (AIdx(j) < sec_idx_ && room_[AIdx(j)] == 0)
+          return;
+    }
+    Index first = -1;
+    for (size_t k = 0; k < cols.size(); k++) {
+      const int j = cols[k];
+      assert(0 <= j && size_t(AIdx(j)) < O_.size());
+      O_[AIdx(j)]++; // Increment the number of ones in the j-th column.
+      Index idx;
+      if (next == nullptr) {
+        assert(C_.size() < size_t(std::numeric_limits<Index>::max()));
+        idx = C_.size();
+        C_.emplace_back(Cell<Index>{});
+        I_.push_back(i);
+      } else {
+        idx = (*next)[AIdx(j)]++;
+        I_[idx] = i;
+      }
+      auto &c = C_[idx];
+      c.h = AIdx(j);
+      c.u = C_[AIdx(j)].u;
+      c.d = AIdx(j);
+      C_[c.u].d = C_[AIdx(j)].u = idx;
+      if (first == -1) { // First in the row!
+        c.l = c.r = first = R_[i] = idx;
+      } else {
+        c.l = C_[first].l;
+        c.r = first;
+        C_[c.l].r = C_[first].l = idx;
+      }
+      if (!colors.empty() && colors[k] != 0) {
+        assert(colors[k] > 0 && AIdx(j) >= sec_idx_);
+        if (K_.size() < C_.size())
+          K_.resize(C_.size(), 0);
+        K_[idx] = colors[k];
+      }
+    }
+  }
+
+  // Extends the colors, if any, to the cells appended after the last
+  // colored one.
+  void FinishColors() {
+    if (Colored())
+      K_.resize(C_.size(), 0);
+  }
+
+  // Commits the rows of the primary columns that Hide(..) left with a
+  // single row, and of those left so by these in turn, pushing them
+  // onto trail_. Returns false (leaving them to Unpropagate(..)) as
+  // soon as an active primary column has no rows left.
+  bool Propagate() {
+    while (!units_.empty()) {
+      const Index hdr_idx = units_.back();
+      units_.pop_back();
+      if (C_[C_[hdr_idx].r].l != hdr_idx || O_[hdr_idx] > 1)
+        continue; // Covered since, or outdated.
+      if (O_[hdr_idx] == 0) {
+        units_.clear();
+        return false;
+      }
+      Cover(hdr_idx);
+      trail_.push_back(C_[hdr_idx].d);
+      ChooseRow(C_[hdr_idx].d, &chosen_);
+      stats_.Forced();
+    }
+    return true;
+  }
+
+  // Undoes the rows committed by Propagate(..) down to the first
+  // `trail` ones.
+  void Unpropagate(size_t trail) {
+    while (trail_.size() > trail) {
+      const Index c1_idx = trail_.back();
+      trail_.pop_back();
+      UnchooseRow(c1_idx, &chosen_);
+      Uncover(C_[c1_idx].h);
+    }
+  }
+
+  // The (column, color) pairs of the row at index `row_idx` (in the
+  // input matrix), by column.
+  void RowCells(int row_idx, std::vector<std::pair<int, int>> *cells) const {
+    cells->clear();
+    if (R_[row_idx] == -1)
+      return;
+    Index c1_idx = R_[row_idx];
+    do {
+      cells->push_back({CIdx(C_[c1_idx].h), Colored() ? K_[c1_idx] : 0});
+      c1_idx = C_[c1_idx].r;
+    } while (c1_idx != R_[row_idx]);
+    std::sort(cells->begin(), cells->end());
+  }
+
+  // The row permutations of the group generated by symmetries_,
+  // starting with the identity.
+  std::vector<std::vector<int>> SymmetryGroup() const {
+    std::vector<std::vector<int>> group(1, std::vector<int>(R_.size()));
+    for (size_t i = 0; i < R_.size(); i++)
+      group[0][i] = i;
+    std::set<std::vector<int>> seen{group[0]};
+    for (size_t k = 0; k < group.size(); k++) {
+      for (const auto &generator : symmetries_) {
+        std::vector<int> product(R_.size());
+        for (size_t i = 0; i < R_.size(); i++)
+          product[i] = generator[group[k][i]];
+        if (seen.insert(product).second)
+          group.push_back(std::move(product));
+      }
+    }
+    return group;
+  }
+
+  // Whether an active primary column has no rows left.
+  bool HasEmptyPrimaryColumn() const {
+    for (Index hdr_idx = C_[0].r; hdr_idx != 0 && hdr_idx < sec_idx_;
+         hdr_idx = C_[hdr_idx].r) {
+      if (O_[hdr_idx] == 0)
+        return true;
+    }
+    return false;
+  }
+
+  // Whether the row of c1_idx has a 1 in the column hdr_idx.
+  bool RowHas(Index c1_idx, Index hdr_idx) const {
+    Index c2_idx = c1_idx;
+    do {
+      if (C_[c2_idx].h == hdr_idx)
+        return true;
+      c2_idx = C_[c2_idx].r;
+    } while (c2_idx != c1_idx);
+    return false;
+  }
+
+  // The cell of the row of c1_idx in its leftmost active primary
+  // column, or -1 if there is none.
+  Index LeftmostPrimary(Index c1_idx) const {
+    Index best_idx = -1;
+    Index c2_idx = c1_idx;
+    do {
+      const Index hdr_idx = C_[c2_idx].h;
+      if (hdr_idx < sec_idx_ && (best_idx == -1 || hdr_idx < C_[best_idx].h))
+        best_idx = c2_idx;
+      c2_idx = C_[c2_idx].r;
+    } while (c2_idx != c1_idx);
+    return best_idx;
+  }
+
+  // Whether any 1 in the column hdr_idx is colored.
+  bool ColumnColored(Index hdr_idx) const {
+    if (K_[hdr_idx] != 0)
+      return true;
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
          c1_idx = C_[c1_idx].d) {
-      for (int c2_idx = C_[c1_idx].r; C_[c2_idx].h != hdr_idx;
-           c2_idx = C_[c2_idx].r) {
-        auto &c = C_[c2_idx];
-        C_[c.u].d = c.d;
-        C_[c.d].u = c.u;
-        O_[C_[c2_idx].h]--;
+      if (K_[c1_idx] != 0)
+        return true;
+    }
+    return false;
+  }
+
+  // Unlinks the column hdr_idx and its cells for good, leaving its rows
+  // in the other columns. For Reduce(..), which rebuilds the arena.
+  void DropColumn(Index hdr_idx) {
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      auto &c = C_[c1_idx];
+      C_[c.l].r = c.r;
+      C_[c.r].l = c.l;
+      if (R_[I_[c1_idx]] == c1_idx)
+        R_[I_[c1_idx]] = c.r;
+    }
+    C_[hdr_idx].u = C_[hdr_idx].d = hdr_idx;
+    O_[hdr_idx] = 0;
+    C_[C_[hdr_idx].l].r = C_[hdr_idx].r;
+    C_[C_[hdr_idx].r].l = C_[hdr_idx].l;
+    ColumnPickingPolicy::OnUnlinkColumn(*this, hdr_idx);
+    ncols_--;
+  }
+
+  // Rebuilds the arena from its active rows and columns, keeping the
+  // column and row indices, and the selected rows as fixed.
+  void Rebuild() {
+    const int nrows = R_.size(), ncols = O_.size() - 1;
+    std::vector<bool> active(ncols + 1, false), live(nrows, false);
+    // A column given a color by Purify(..) holds no live rows of other
+    // colors, while those of its color are compatible, so the live 1s
+    // in such columns are left out.
+    auto purified = [this](Index hdr_idx) {
+      return Colored() && K_[hdr_idx] != 0;
+    };
+    for (Index hdr_idx = C_[0].r; hdr_idx != 0; hdr_idx = C_[hdr_idx].r) {
+      active[hdr_idx] = true;
+      if (purified(hdr_idx))
+        continue;
+      for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+           c1_idx = C_[c1_idx].d)
+        live[I_[c1_idx]] = true;
+    }
+    std::vector<std::vector<int>> rows(nrows), colors(nrows);
+    for (int i = 0; i < nrows; i++) {
+      if (!live[i])
+        continue;
+      Index c1_idx = R_[i];
+      do {
+        if (!purified(C_[c1_idx].h)) {
+          rows[i].push_back(CIdx(C_[c1_idx].h));
+          if (Colored())
+            colors[i].push_back(K_[c1_idx]);
+        }
+        c1_idx = C_[c1_idx].r;
+      } while (c1_idx != R_[i]);
+    }
+    std::vector<int> selected = std::move(selected_);
+    InitializeHeaders(nrows, ncols, CIdx(sec_idx_));
+    for (int j = 0; j < ncols; j++) {
+      if (!active[AIdx(j)]) {
+        C_[C_[AIdx(j)].l].r = C_[AIdx(j)].r;
+        C_[C_[AIdx(j)].r].l = C_[AIdx(j)].l;
+        ncols_--;
       }
+    }
+    nrows_ = 0;
+    for (int i = 0; i < nrows; i++) {
+      if (live[i]) {
+        AppendRow(i, rows[i], colors[i], nullptr);
+        nrows_++;
+      }
+    }
+    FinishColors();
+    selected_ = std::move(selected);
+    nfixed_ = selected_.size();
+    ColumnPickingPolicy::OnInitialize(*this);
+  }
+
+  // Covers the column whose arena index is specified.
+  void Cover(Index hdr_idx) {
+    long updates = 1;
+    for (Index c1_idx = C_[hdr_idx].d; c1_idx != hdr_idx;
+         c1_idx = C_[c1_idx].d) {
+      updates += Hide(c1_idx);
       nrows_--;
     }
     // Unlink the column.
     C_[C_[hdr_idx].l].r = C_[hdr_idx].r;
     C_[C_[hdr_idx].r].l = C_[hdr_idx].l;
+    ColumnPickingPolicy::OnUnlinkColumn(*this, hdr_idx);
     ncols_--;
+    stats_.Cover(updates);
   }
 
   // Uncovers the column whose arena index is specified.
-  void Uncover(int hdr_idx) {
+  void Uncover(Index hdr_idx) {
+    long updates = 1;
     // Link the column.
     ncols_++;
     C_[C_[hdr_idx].l].r = hdr_idx;
     C_[C_[hdr_idx].r].l = hdr_idx;
-    for (int c1_idx = C_[hdr_idx].u; C_[c1_idx].row_idx != -1;
+    ColumnPickingPolicy::OnRelinkColumn(*this, hdr_idx);
+    for (Index c1_idx = C_[hdr_idx].u; c1_idx != hdr_idx;
          c1_idx = C_[c1_idx].u) {
       nrows_++;
-      for (int c2_idx = C_[c1_idx].l; C_[c2_idx].h != hdr_idx;
-           c2_idx = C_[c2_idx].l) {
-        auto &c = C_[c2_idx];
-        O_[C_[c2_idx].h]++;
-        C_[c.d].u = c2_idx;
-        C_[c.u].d = c2_idx;
-      }
+      updates += Unhide(c1_idx);
+    }
+    stats_.Uncover(updates);
+  }
+
+  // Unlinks the cells of the row containing c1_idx, other than c1_idx
+  // itself, from their columns and returns the number of links updated.
+  // Cells marked by Purify(..) stay in their column.
+  long Hide(Index c1_idx) {
+    long updates = 0;
+    const bool colored = Colored();
+    for (Index c2_idx = C_[c1_idx].r; c2_idx != c1_idx;
+         c2_idx = C_[c2_idx].r) {
+      if (colored && K_[c2_idx] < 0)
+        continue;
+      auto &c = C_[c2_idx];
+      C_[c.u].d = c.d;
+      C_[c.d].u = c.u;
+      updates++;
+      O_[c.h]--;
+      ColumnPickingPolicy::OnCountChange(*this, c.h);
+      if (propagate_ && O_[c.h] <= 1 && c.h < sec_idx_)
+        units_.push_back(c.h);
+    }
+    return updates;
+  }
+
+  // Inverse of Hide(..).
+  long Unhide(Index c1_idx) {
+    long updates = 0;
+    const bool colored = Colored();
+    for (Index c2_idx = C_[c1_idx].l; c2_idx != c1_idx;
+         c2_idx = C_[c2_idx].l) {
+      if (colored && K_[c2_idx] < 0)
+        continue;
+      auto &c = C_[c2_idx];
+      O_[c.h]++;
+      ColumnPickingPolicy::OnCountChange(*this, c.h);
+      C_[c.d].u = c2_idx;
+      C_[c.u].d = c2_idx;
+      updates++;
     }
+    return updates;
   }
 
   /////////////////////
@@ -285,16 +1761,94 @@ private:
   // Number of active rows and columns.
   int nrows_, ncols_;
   // Count active ones in a given column. Arena indices!
-  std::vector<int> O_;
+  ArenaVector<int> O_;
   // Arena for storing all the cells. Cell at index zero is a special
   // sentinel cell that is guaranteed to exist and C_[0].r points to
   // the first header cell aka that of column at index zero.
-  std::vector<Cell> C_;
+  ArenaVector<Cell<Index>> C_;
+  // Row index (in the matrix) of each cell in the arena, or -1 for the
+  // headers. Only needed when a row is chosen, so it is kept apart
+  // from the links that Cover(..)/Uncover(..) walk over.
+  ArenaVector<int> I_;
+  // Color of each cell (zero if uncolored, -1 if marked by Purify(..))
+  // and of each secondary header (the color given by Purify(..), if
+  // any). Empty unless the instance has colored 1s, so that uncolored
+  // instances neither store nor check colors.
+  ArenaVector<int> K_;
+  // Rows still needed by (lo minus those taken, so possibly negative),
+  // and still allowed in, each primary column (by arena index) with
+  // multiplicities. Empty for exact cover instances.
+  ArenaVector<int> need_, room_;
+  // Rows excluded by the open nodes of MSolve(..), innermost last.
+  std::vector<Index> excluded_;
   // The arena index of the first secondary column. A secondary
   // column need not be covered, and in each instance we assume they
   // are grouped together so that all primary columns come before
   // all secondary columns.
   int sec_idx_;
+  // Arena index of some cell in each row of the input matrix (-1 for
+  // rows without any 1s).
+  ArenaVector<Index> R_;
+  // Rows forced into the solution through SelectRow(..), in order,
+  // the first nfixed_ of which were made permanent by Reduce(..).
+  std::vector<int> selected_;
+  size_t nfixed_ = 0;
+  // Row permutations declared through AddSymmetry(..).
+  std::vector<std::vector<int>> symmetries_;
+  // Preallocated search stack of ISolve(..), one frame per primary
+  // column, and the rows of the partial solution.
+  std::vector<Frame> frames_;
+  std::vector<int> chosen_;
+  // With Propagation::SINGLETONS, the primary columns Hide(..) left
+  // with at most one row since the last Propagate(..), and the cells
+  // of the rows it committed, oldest first.
+  bool propagate_ = false;
+  std::vector<Index> units_, trail_;
+  // Observer of the search (see stats.h).
+  StatsPolicy stats_;
+};
+
+// See DancingLinks::Solutions().
+template <class ColumnPickingPolicy, class Index, class StatsPolicy>
+class DancingLinks<ColumnPickingPolicy, Index, StatsPolicy>::SolutionIterator {
+public:
+  explicit SolutionIterator(DancingLinks *dlx,
+                            const Checkpoint *checkpoint = nullptr)
+      : dlx_(dlx) {
+    assert(!dlx->Multiplicities()); // Not supported.
+    dlx_->stats_.Start();
+    dlx_->chosen_ = dlx_->selected_;
+    if (checkpoint != nullptr)
+      dlx_->RestoreCursor(*checkpoint, &cursor_);
+  }
+  SolutionIterator(SolutionIterator &&other) noexcept
+      : dlx_(other.dlx_), cursor_(other.cursor_) {
+    other.dlx_ = nullptr;
+  }
+  SolutionIterator(const SolutionIterator &) = delete;
+  SolutionIterator &operator=(const SolutionIterator &) = delete;
+  ~SolutionIterator() {
+    if (dlx_ != nullptr)
+      dlx_->AbandonSearch(&cursor_);
+  }
+
+  // The next solution, as it would be visited by Solve(..) and valid
+  // until the following call, or nullptr once there are no more.
+  const std::vector<int> *Next() {
+    assert(dlx_ != nullptr);
+    return dlx_->NextSolution(&cursor_) ? &dlx_->chosen_ : nullptr;
+  }
+
+  // Saves the position of the search, which Solutions(checkpoint)
+  // resumes right after the last solution returned.
+  void Save(Checkpoint *checkpoint) const {
+    assert(dlx_ != nullptr);
+    dlx_->SaveCursor(cursor_, checkpoint);
+  }
+
+private:
+  DancingLinks *dlx_; // Null once moved from.
+  Cursor cursor_;
 };
 
 } // namespace dlx
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dlx {
+
+// A pool of search jobs shared by the workers of a parallel solve. A
+// job is a prefix of the search tree, i.e. a list of row indices to
+// select before searching the remaining subtree. Every worker owns a
+// deque: it pushes and pops its own jobs at the back (depth first)
+// while idle workers steal from the front of the others, where the
+// shallowest and hence largest subtrees sit.
+class JobPool {
+public:
+  explicit JobPool(int num_workers)
+      : queues_(num_workers), outstanding_(0), idle_(0), stopped_(false) {}
+
+  // Adds a job to the deque of `worker`.
+  void Push(int worker, std::vector<int> &&job) {
+    outstanding_++;
+    std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+    queues_[worker].jobs.push_back(std::move(job));
+  }
+
+  // Fetches a job for `worker`, stealing one if its own deque is
+  // empty. Blocks until a job is available and returns false once all
+  // the jobs are done (or the search was stopped).
+  bool Pop(int worker, std::vector<int> *job) {
+    bool waiting = false;
+    while (!stopped_ && outstanding_ > 0) {
+      if (TryPop(worker, job)) {
+        if (waiting)
+          idle_--;
+        return true;
+      }
+      if (!waiting) {
+        waiting = true;
+        idle_++;
+      }
+      std::this_thread::yield();
+    }
+    if (waiting)
+      idle_--;
+    return false;
+  }
+
+  // Marks a previously popped job as completed.
+  void Done() { outstanding_--; }
+
+  // True when some worker is waiting for a job, which is the signal
+  // for busy workers to split off part of their subtree.
+  bool Hungry() const { return idle_.load(std::memory_order_relaxed) > 0; }
+
+  // Abandons all the remaining jobs.
+  void Stop() { stopped_ = true; }
+  bool Stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+private:
+  bool TryPop(int worker, std::vector<int> *job) {
+    {
+      auto &own = queues_[worker];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.jobs.empty()) {
+        *job = std::move(own.jobs.back());
+        own.jobs.pop_back();
+        return true;
+      }
+    }
+    for (size_t k = 1; k < queues_.size(); k++) {
+      auto &victim = queues_[(worker + k) % queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.jobs.empty()) {
+        *job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::vector<int>> jobs;
+  };
+  std::vector<Queue> queues_;
+  // Jobs pushed but not yet done, and workers waiting for a job.
+  std::atomic<int> outstanding_, idle_;
+  std::atomic<bool> stopped_;
+};
+
+} // namespace dlx
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <vector>
 
 namespace dlx {
@@ -8,14 +10,95 @@ namespace dlx {
 // columns indices are zero-based and in the case that there are no
 // secondary columns in the instance, FirstSecondaryColumnIndex()
 // and Cols() should return identical values.
+//
+// A 1 in a secondary column may carry a positive color (Knuth's
+// Algorithm C): any number of rows may then share the column, as long
+// as their 1s in it have the same color. An uncolored 1 (color zero)
+// claims the column exclusively, as usual.
+//
+// A primary column may also have to be covered between lo and hi
+// times (Knuth's Algorithm M) rather than exactly once, see Bounds(..).
 class MatrixInterface {
 public:
   virtual int Rows() = 0;
   virtual int Cols() = 0;
   virtual int Value(int i, int j) = 0;
   virtual int FirstSecondaryColumnIndex() = 0;
+  // Color of the 1 at (i, j). Only called where Value(i, j) == 1.
+  virtual int Color(int i, int j) { return 0; }
+  // Bounds on the number of rows of a solution with a 1 in the primary
+  // column j, where 0 <= lo <= hi.
+  virtual void Bounds(int j, int *lo, int *hi) { *lo = *hi = 1; }
 };
 
+// Interface class for sparse matrices. Instead of probing every cell
+// through Value(..), the solver asks for the column indices of the 1s
+// in each row, which lets it build its arena in time proportional to
+// the number of 1s. Implementations should list the column indices of
+// a row in increasing order so that the solver behaves exactly as it
+// would on the equivalent dense matrix.
+class SparseMatrixInterface : public MatrixInterface {
+public:
+  // Total number of 1s in the matrix.
+  virtual int NonZeros() = 0;
+  // Overwrites `cols` with the column indices of the 1s in row i.
+  virtual void Row(int i, std::vector<int> *cols) = 0;
+  // Overwrites `colors` with the colors of the 1s in row i, in the
+  // order of Row(..), or clears it if none of them is colored.
+  virtual void Colors(int i, std::vector<int> *colors) { colors->clear(); }
+
+  // Dense access in terms of Row(..). Implementations that can answer
+  // this more cheaply are free to override it.
+  int Value(int i, int j) override {
+    Row(i, &scratch_);
+    return std::find(scratch_.begin(), scratch_.end(), j) != scratch_.end();
+  }
+  int Color(int i, int j) override {
+    Row(i, &scratch_);
+    int k = std::find(scratch_.begin(), scratch_.end(), j) - scratch_.begin();
+    Colors(i, &scratch_);
+    return k < int(scratch_.size()) ? scratch_[k] : 0;
+  }
+
+private:
+  std::vector<int> scratch_;
+};
+
+// Whether the instance is a plain exact cover one, without bounds on
+// its primary columns (see MatrixInterface::Bounds(..)) or colored 1s,
+// as the engines other than DancingLinks require.
+inline bool IsExactCover(MatrixInterface &matrix) {
+  for (int j = 0; j < matrix.FirstSecondaryColumnIndex(); j++) {
+    int lo, hi;
+    matrix.Bounds(j, &lo, &hi);
+    if (lo != 1 || hi != 1)
+      return false;
+  }
+  for (int i = 0; i < matrix.Rows(); i++)
+    for (int j = 0; j < matrix.Cols(); j++)
+      if (matrix.Value(i, j) == 1 && matrix.Color(i, j) != 0)
+        return false;
+  return true;
+}
+
+// Same in O(rows + cols + ones).
+inline bool IsExactCover(SparseMatrixInterface &matrix) {
+  for (int j = 0; j < matrix.FirstSecondaryColumnIndex(); j++) {
+    int lo, hi;
+    matrix.Bounds(j, &lo, &hi);
+    if (lo != 1 || hi != 1)
+      return false;
+  }
+  std::vector<int> colors;
+  for (int i = 0; i < matrix.Rows(); i++) {
+    matrix.Colors(i, &colors);
+    for (int color : colors)
+      if (color != 0)
+        return false;
+  }
+  return true;
+}
+
 // Example implementation.
 template <class T> class MatrixFromVector : public MatrixInterface {
 public:
@@ -31,4 +114,70 @@ private:
   int sec_idx_;
 };
 
+// Sparse counterpart of MatrixFromVector. The input is a list of rows,
+// each holding the (increasing) column indices of its 1s, and is
+// stored in compressed sparse row (CSR) form. The optional `colors`
+// parallel `rows` entry by entry.
+class SparseMatrixFromVector : public SparseMatrixInterface {
+public:
+  SparseMatrixFromVector(const std::vector<std::vector<int>> &rows, int cols,
+                         int sec_idx,
+                         const std::vector<std::vector<int>> &colors = {})
+      : cols_(cols), sec_idx_(sec_idx) {
+    assert(colors.empty() || colors.size() == rows.size());
+    offsets_.reserve(rows.size() + 1);
+    offsets_.push_back(0);
+    for (size_t i = 0; i < rows.size(); i++) {
+      assert(std::is_sorted(rows[i].begin(), rows[i].end()));
+      idxs_.insert(idxs_.end(), rows[i].begin(), rows[i].end());
+      if (!colors.empty()) {
+        assert(colors[i].size() == rows[i].size());
+        colors_.insert(colors_.end(), colors[i].begin(), colors[i].end());
+      }
+      offsets_.push_back(idxs_.size());
+    }
+  }
+  int Rows() override { return offsets_.size() - 1; }
+  int Cols() override { return cols_; }
+  int NonZeros() override { return idxs_.size(); }
+  void Row(int i, std::vector<int> *cols) override {
+    cols->assign(idxs_.begin() + offsets_[i], idxs_.begin() + offsets_[i + 1]);
+  }
+  void Colors(int i, std::vector<int> *colors) override {
+    if (colors_.empty())
+      colors->clear();
+    else
+      colors->assign(colors_.begin() + offsets_[i],
+                     colors_.begin() + offsets_[i + 1]);
+  }
+  int Value(int i, int j) override {
+    return std::binary_search(idxs_.begin() + offsets_[i],
+                              idxs_.begin() + offsets_[i + 1], j);
+  }
+  int FirstSecondaryColumnIndex() override { return sec_idx_; }
+  void Bounds(int j, int *lo, int *hi) override {
+    *lo = lo_.empty() ? 1 : lo_[j];
+    *hi = hi_.empty() ? 1 : hi_[j];
+  }
+
+  // Sets the bounds of the primary column j (1 and 1 by default).
+  void SetBounds(int j, int lo, int hi) {
+    assert(0 <= j && j < sec_idx_ && 0 <= lo && lo <= hi);
+    if (lo_.empty()) {
+      lo_.assign(sec_idx_, 1);
+      hi_.assign(sec_idx_, 1);
+    }
+    lo_[j] = lo;
+    hi_[j] = hi;
+  }
+
+private:
+  int cols_;
+  // Row i owns the entries idxs_[offsets_[i]] .. idxs_[offsets_[i + 1] - 1].
+  std::vector<int> offsets_, idxs_;
+  std::vector<int> colors_; // Parallel to idxs_, or empty if uncolored.
+  std::vector<int> lo_, hi_; // Per primary column, or empty if all 1.
+  int sec_idx_;
+};
+
 } // namespace dlx
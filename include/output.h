@@ -0,0 +1,136 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace dlx {
+
+// Collects formatted output in a reusable buffer and hands it to a file
+// descriptor (or a stream) in blocks of about kBlockSize bytes, so that
+// writing a solution costs a few appends instead of a stream operation
+// per number. Whatever is left is written by Flush() or on destruction.
+class OutputBuffer {
+public:
+  static constexpr size_t kBlockSize = 1 << 16;
+
+  explicit OutputBuffer(int fd) : fd_(fd) { buffer_.reserve(2 * kBlockSize); }
+  explicit OutputBuffer(std::ostream *out) : out_(out) {
+    buffer_.reserve(2 * kBlockSize);
+  }
+  OutputBuffer(const OutputBuffer &) = delete;
+  OutputBuffer &operator=(const OutputBuffer &) = delete;
+  ~OutputBuffer() { Flush(); }
+
+  void Put(char c) { buffer_.push_back(c); }
+  void Put(const char *data, size_t size) { buffer_.append(data, size); }
+  void PutInt(long value) {
+    char digits[24];
+    buffer_.append(digits, std::to_chars(digits, digits + 24, value).ptr);
+  }
+  // LEB128: 7 bits per byte, least significant first.
+  void PutVarint(uint64_t value) {
+    for (; value >= 0x80; value >>= 7)
+      buffer_.push_back(char(value | 0x80));
+    buffer_.push_back(char(value));
+  }
+
+  // Marks the end of a record, writing the buffer once it fills a block.
+  void EndRecord() {
+    if (buffer_.size() >= kBlockSize)
+      Flush();
+  }
+
+  void Flush() {
+    if (out_ != nullptr) {
+      out_->write(buffer_.data(), buffer_.size());
+      failed_ = failed_ || !*out_;
+    } else {
+      for (size_t done = 0; done < buffer_.size();) {
+        ssize_t n = ::write(fd_, buffer_.data() + done, buffer_.size() - done);
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n <= 0) {
+          failed_ = true;
+          break;
+        }
+        done += n;
+      }
+    }
+    buffer_.clear();
+  }
+
+  // Whether any write failed so far.
+  bool Failed() const { return failed_; }
+
+private:
+  int fd_ = -1;
+  std::ostream *out_ = nullptr;
+  std::string buffer_;
+  bool failed_ = false;
+};
+
+// Text format of a solution: its rows in decimal, separated by spaces,
+// on one line.
+inline void PutText(const std::vector<int> &solution, OutputBuffer *out) {
+  for (size_t k = 0; k < solution.size(); k++) {
+    if (k > 0)
+      out->Put(' ');
+    out->PutInt(solution[k]);
+  }
+  out->Put('\n');
+  out->EndRecord();
+}
+
+// Binary format of a solution: the number of rows, then each row as
+// the difference from the previous one (from 0), all as varints. The
+// differences are zigzag encoded (0, -1, 1, -2, .. as 0, 1, 2, 3, ..)
+// to keep the order of the rows, and take a byte or two for rows
+// listed in about increasing order.
+inline void PutBinary(const std::vector<int> &solution, OutputBuffer *out) {
+  out->PutVarint(solution.size());
+  long prev = 0;
+  for (int row_idx : solution) {
+    long delta = row_idx - prev;
+    out->PutVarint(uint64_t(delta) << 1 ^ uint64_t(delta >> 63));
+    prev = row_idx;
+  }
+  out->EndRecord();
+}
+
+// Reads back a solution written by PutBinary(..). Returns false at the
+// end of the input or on a truncated record.
+inline bool GetBinary(std::istream &in, std::vector<int> *solution) {
+  auto get_varint = [&in](uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int byte = in.get();
+      if (byte == std::char_traits<char>::eof())
+        return false;
+      *value |= uint64_t(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return true;
+    }
+    return false;
+  };
+  uint64_t size, zigzag;
+  if (!get_varint(&size))
+    return false;
+  solution->resize(size);
+  long prev = 0;
+  for (int &row_idx : *solution) {
+    if (!get_varint(&zigzag))
+      return false;
+    prev += long(zigzag >> 1) ^ -long(zigzag & 1);
+    row_idx = prev;
+  }
+  return true;
+}
+
+} // namespace dlx
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <random>
 #include <vector>
 
@@ -14,14 +17,31 @@ namespace dlx {
 // single static ChooseColumn(..) method must be defined which should
 // return a valid arena index of some active primary column (or -1 in
 // case there are no such columns).
+//
+// Policies that maintain their own data structures can also observe
+// every change to the instance through the static hooks below, which
+// the solver calls right after the change. Stateless policies inherit
+// the empty defaults, which compile away.
 
-struct FirstAvailableColumn {
+struct StatelessPolicy {
+  // The instance was (re)initialized.
+  template <class T> static void OnInitialize(T &dlx) {}
+  // The column with arena index hdr_idx was unlinked (covered).
+  template <class T> static void OnUnlinkColumn(T &dlx, int hdr_idx) {}
+  // The column with arena index hdr_idx was linked back (uncovered).
+  template <class T> static void OnRelinkColumn(T &dlx, int hdr_idx) {}
+  // The number of ones in an active column changed by one, or on
+  // instances with multiplicities, the number of rows it still needs.
+  template <class T> static void OnCountChange(T &dlx, int hdr_idx) {}
+};
+
+struct FirstAvailableColumn : StatelessPolicy {
   template <class T> static int ChooseColumn(const T &dlx) {
     return dlx.C_[0].r != 0 && dlx.C_[0].r < dlx.sec_idx_ ? dlx.C_[0].r : -1;
   }
 };
 
-struct LastAvailableColumn {
+struct LastAvailableColumn : StatelessPolicy {
   template <class T> static int ChooseColumn(const T &dlx) {
     int hdr_idx = dlx.C_[0].l;
     while (hdr_idx != 0 && hdr_idx >= dlx.sec_idx_)
@@ -30,26 +50,78 @@ struct LastAvailableColumn {
   }
 };
 
-struct UniformlyRandomColumn {
+// Random numbers for the randomized policies, owned by each solver so
+// that runs are reproducible from the seed and solvers on different
+// threads share nothing.
+class RandomSource {
+public:
+  static constexpr uint32_t kDefaultSeed = 5489;
+
+  void Seed(uint32_t seed) { gen_.seed(seed); }
+
+  // Uniform in [0, n) for 0 < n < 2^31, from a single draw by
+  // multiply-shift (Lemire), which is off by less than n / 2^32.
+  // Drawing does not change the instance, hence const.
+  int Below(int n) const { return (uint64_t(gen_()) * uint32_t(n)) >> 32; }
+
+private:
+  mutable std::mt19937 gen_{kDefaultSeed};
+};
+
+// Picks an active primary column uniformly at random. The active
+// primary columns are kept in an array (in no particular order) by the
+// hooks, so that the pick is O(1). The choices are those of the
+// solver's RandomSource, which Seed(..) resets.
+class UniformlyRandomColumn : public RandomSource {
+public:
   template <class T> static int ChooseColumn(const T &dlx) {
-    if (dlx.C_[0].r == 0 || dlx.C_[0].r >= dlx.sec_idx_)
-      return -1;
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    std::uniform_real_distribution<double> uniform(0.0, 1.0);
-    int hdr_idx = dlx.C_[0].r;
-    int rnd_idx = hdr_idx, i = 1;
-    while (hdr_idx != 0 && hdr_idx < dlx.sec_idx_) {
-      rnd_idx = ((uniform(gen) <= double(1.0) / i) ? hdr_idx : rnd_idx);
-      hdr_idx = dlx.C_[hdr_idx].r;
-      i++;
-    }
-    return rnd_idx;
+    const auto &self = static_cast<const UniformlyRandomColumn &>(dlx);
+    return self.active_.empty() ? -1
+                                : self.active_[self.Below(self.active_.size())];
+  }
+
+  template <class T> static void OnInitialize(T &dlx) {
+    auto &self = static_cast<UniformlyRandomColumn &>(dlx);
+    self.active_.clear();
+    self.where_.assign(dlx.sec_idx_, -1);
+    for (int hdr_idx = dlx.C_[0].r; hdr_idx != 0 && hdr_idx < dlx.sec_idx_;
+         hdr_idx = dlx.C_[hdr_idx].r)
+      self.Insert(hdr_idx);
   }
+  template <class T> static void OnUnlinkColumn(T &dlx, int hdr_idx) {
+    if (hdr_idx < dlx.sec_idx_)
+      static_cast<UniformlyRandomColumn &>(dlx).Remove(hdr_idx);
+  }
+  template <class T> static void OnRelinkColumn(T &dlx, int hdr_idx) {
+    if (hdr_idx < dlx.sec_idx_)
+      static_cast<UniformlyRandomColumn &>(dlx).Insert(hdr_idx);
+  }
+  template <class T> static void OnCountChange(T &dlx, int hdr_idx) {}
+
+private:
+  void Insert(int hdr_idx) {
+    where_[hdr_idx] = active_.size();
+    active_.push_back(hdr_idx);
+  }
+  // Moves the last active column into the place of hdr_idx.
+  void Remove(int hdr_idx) {
+    int last = active_.back(), pos = where_[hdr_idx];
+    active_[pos] = last;
+    where_[last] = pos;
+    active_.pop_back();
+  }
+
+  // The active primary columns, and the position of each in active_.
+  std::vector<int> active_, where_;
 };
 
-struct ColumnWithLeastOnes {
+// On instances with multiplicities, picks the column with the fewest
+// branches (see DancingLinks::Branching(..)), which favors the columns
+// with the least slack between their ones and the rows they need.
+struct ColumnWithLeastOnes : StatelessPolicy {
   template <class T> static int ChooseColumn(const T &dlx) {
+    if (dlx.Multiplicities())
+      return ChooseColumnWithLeastSlack(dlx);
     int best_idx = -1, best_val = dlx.nrows_ + 1;
     for (int hdr_idx = dlx.C_[0].r; hdr_idx != 0 && hdr_idx < dlx.sec_idx_;
          hdr_idx = dlx.C_[hdr_idx].r) {
@@ -60,6 +132,103 @@ struct ColumnWithLeastOnes {
     }
     return best_idx;
   }
+
+private:
+  template <class T> static int ChooseColumnWithLeastSlack(const T &dlx) {
+    int best_idx = -1, best_val = std::numeric_limits<int>::max();
+    for (int hdr_idx = dlx.C_[0].r; hdr_idx != 0 && hdr_idx < dlx.sec_idx_;
+         hdr_idx = dlx.C_[hdr_idx].r) {
+      if (dlx.Branching(hdr_idx) < best_val) {
+        best_val = dlx.Branching(hdr_idx);
+        best_idx = hdr_idx;
+      }
+    }
+    return best_idx;
+  }
+};
+
+// Picks a column with the least ones, like ColumnWithLeastOnes,
+// without scanning all the active columns. The active primary columns
+// are kept in buckets (doubly linked lists) indexed by their number
+// of ones (their slack on instances with multiplicities, clamped at
+// zero), which the hooks keep current in O(1) per change. A column is
+// picked from the first nonempty bucket: its head if the columns in
+// it have no or a single choice (the branch fails or is forced either
+// way), otherwise the leftmost one to follow ColumnWithLeastOnes. A
+// pick thus costs a walk over the empty buckets before it, plus a
+// scan of its bucket if the columns there have two or more ones.
+// Forced rows lead to the same state in any order, so solutions come
+// in the same order, but rows within a solution may be listed in a
+// different order.
+class BucketedColumnWithLeastOnes {
+public:
+  template <class T> static int ChooseColumn(const T &dlx) {
+    const auto &self = static_cast<const BucketedColumnWithLeastOnes &>(dlx);
+    for (int k = 0; k < self.nbuckets_; k++) {
+      int bucket = self.first_bucket_ + k, hdr_idx = self.next_[bucket];
+      if (hdr_idx == bucket)
+        continue;
+      int best_idx = hdr_idx;
+      for (; k > 1 && hdr_idx != bucket; hdr_idx = self.next_[hdr_idx])
+        best_idx = std::min(best_idx, hdr_idx);
+      return best_idx;
+    }
+    return -1;
+  }
+
+  template <class T> static void OnInitialize(T &dlx) {
+    auto &self = static_cast<BucketedColumnWithLeastOnes &>(dlx);
+    // Headers occupy arena indices 1 .. sec_idx_ - 1, the buckets come
+    // right after them.
+    self.first_bucket_ = dlx.sec_idx_;
+    // Up to nrows_ ones, or nrows_ + 1 branches with multiplicities.
+    self.nbuckets_ = dlx.nrows_ + 2;
+    int nnodes = self.first_bucket_ + self.nbuckets_;
+    self.next_.resize(nnodes);
+    self.prev_.resize(nnodes);
+    for (int bucket = self.first_bucket_; bucket < nnodes; bucket++)
+      self.next_[bucket] = self.prev_[bucket] = bucket;
+    for (int hdr_idx = dlx.C_[0].r; hdr_idx != 0 && hdr_idx < dlx.sec_idx_;
+         hdr_idx = dlx.C_[hdr_idx].r)
+      self.Insert(hdr_idx, Key(dlx, hdr_idx));
+  }
+  template <class T> static void OnUnlinkColumn(T &dlx, int hdr_idx) {
+    if (hdr_idx < dlx.sec_idx_)
+      static_cast<BucketedColumnWithLeastOnes &>(dlx).Remove(hdr_idx);
+  }
+  template <class T> static void OnRelinkColumn(T &dlx, int hdr_idx) {
+    if (hdr_idx < dlx.sec_idx_)
+      static_cast<BucketedColumnWithLeastOnes &>(dlx).Insert(
+          hdr_idx, Key(dlx, hdr_idx));
+  }
+  template <class T> static void OnCountChange(T &dlx, int hdr_idx) {
+    if (hdr_idx < dlx.sec_idx_) {
+      auto &self = static_cast<BucketedColumnWithLeastOnes &>(dlx);
+      self.Remove(hdr_idx);
+      self.Insert(hdr_idx, Key(dlx, hdr_idx));
+    }
+  }
+
+private:
+  template <class T> static int Key(const T &dlx, int hdr_idx) {
+    return std::max(0, dlx.Branching(hdr_idx));
+  }
+  void Insert(int hdr_idx, int count) {
+    int bucket = first_bucket_ + count;
+    next_[hdr_idx] = next_[bucket];
+    prev_[hdr_idx] = bucket;
+    prev_[next_[bucket]] = hdr_idx;
+    next_[bucket] = hdr_idx;
+  }
+  void Remove(int hdr_idx) {
+    next_[prev_[hdr_idx]] = next_[hdr_idx];
+    prev_[next_[hdr_idx]] = prev_[hdr_idx];
+  }
+
+  // Links of the primary column headers (by arena index) followed by
+  // the sentinels of the buckets for 0, 1, .., nbuckets_ - 1 ones.
+  std::vector<int> next_, prev_;
+  int first_bucket_ = 1, nbuckets_ = 0;
 };
 
 } // namespace dlx
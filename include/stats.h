@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace dlx {
+
+//////////////////////
+// Stats Policies   //
+//////////////////////
+
+// A stats policy is notified of the events of a search by
+// dlx::DancingLinks, which keeps one as a member and exposes it
+// through Stats(). Start() is called at the beginning of every
+// ISolve(..)/RSolve(..), Node(..) at every node of the search tree
+// with its depth (not counting selected rows) and the number of rows
+// of the chosen column, Forced() for every row committed without a
+// node by propagation, and Cover(..)/Uncover(..) with the number of
+// links updated (Knuth's "updates": one per cell removed from or
+// restored to a column, plus one for the header itself).
+
+// Collects nothing. Every hook is empty and inlined away, so that
+// the search runs exactly as if there were no hooks at all.
+struct NoStats {
+  void Start() {}
+  void Node(int depth, int branching) {}
+  void Solution() {}
+  void Forced() {}
+  void Cover(long updates) {}
+  void Uncover(long updates) {}
+};
+
+// Counts the search effort of the last solve.
+struct SearchStats {
+  long nodes = 0, solutions = 0;
+  // Rows committed by propagation (see DancingLinks::SetPropagation(..)).
+  long forced = 0;
+  long covers = 0, uncovers = 0, updates = 0;
+  // Number of nodes and the sum of their branching factors (rows of
+  // the chosen column) at each depth of the tree.
+  std::vector<long> nodes_per_depth, branches_per_depth;
+  // Time from the start of the search to the first solution, or -1
+  // if no solution was found.
+  double seconds_to_first_solution = -1;
+
+  void Start() {
+    *this = SearchStats{};
+    start_ = std::chrono::steady_clock::now();
+  }
+  void Node(int depth, int branching) {
+    nodes++;
+    if (size_t(depth) >= nodes_per_depth.size()) {
+      nodes_per_depth.resize(depth + 1, 0);
+      branches_per_depth.resize(depth + 1, 0);
+    }
+    nodes_per_depth[depth]++;
+    branches_per_depth[depth] += branching;
+  }
+  void Solution() {
+    if (solutions++ == 0)
+      seconds_to_first_solution = std::chrono::duration<double>(
+                                      std::chrono::steady_clock::now() - start_)
+                                      .count();
+  }
+  void Forced() { forced++; }
+  void Cover(long link_updates) {
+    covers++;
+    updates += link_updates;
+  }
+  void Uncover(long link_updates) {
+    uncovers++;
+    updates += link_updates;
+  }
+
+  // Prints the counters and the per-depth profile.
+  void Print(std::ostream &out) const {
+    out << "nodes: " << nodes << ", solutions: " << solutions
+        << ", forced: " << forced << ", covers: " << covers
+        << ", uncovers: " << uncovers << ", updates: " << updates
+        << ", seconds to first solution: " << seconds_to_first_solution
+        << "\n";
+    for (size_t depth = 0; depth < nodes_per_depth.size(); depth++)
+      out << "  depth " << depth << ": " << nodes_per_depth[depth]
+          << " nodes, branching factor "
+          << double(branches_per_depth[depth]) / nodes_per_depth[depth]
+          << "\n";
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace dlx
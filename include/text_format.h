@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <istream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "matrix.h"
+
+namespace dlx {
+
+// An instance in the text format of Knuth's DLX programs. Lines that
+// are blank or start with '|' are comments. The first other line names
+// the items (columns): the primary ones, then a lone '|', then the
+// secondary ones. A primary item may be prefixed by "v|" or "u:v|" to
+// be covered v times, or between u and v times. Each following line is
+// an option (row) listing the names of its items, where a secondary
+// item may carry a color as in "name:color". Rows are numbered from 0
+// in the order of the options.
+class TextInstance {
+public:
+  // Parses an instance from `in`. On errors, returns false and sets
+  // `error` to a message giving the line.
+  bool Read(std::istream &in, std::string *error) {
+    items_.clear();
+    std::unordered_map<std::string, int> item_idxs, color_idxs;
+    std::vector<std::pair<int, int>> bounds; // Per primary item.
+    std::vector<std::vector<int>> rows, colors;
+    int sec_idx = -1;
+    bool colored = false, multiplicities = false;
+    std::string line, token;
+    int line_num = 0;
+    auto fail = [&](const std::string &message) {
+      *error = "line " + std::to_string(line_num) + ": " + message;
+      return false;
+    };
+    while (std::getline(in, line)) {
+      line_num++;
+      std::istringstream tokens(line);
+      if (!(tokens >> token) || token[0] == '|')
+        continue; // Blank or comment.
+      tokens.clear();
+      tokens.seekg(0);
+      if (sec_idx == -1) { // The items.
+        while (tokens >> token) {
+          if (token == "|") {
+            if (sec_idx != -1)
+              return fail("second '|' among the items");
+            sec_idx = items_.size();
+            continue;
+          }
+          int lo = 1, hi = 1;
+          const size_t bar = token.find('|');
+          if (bar != std::string::npos) {
+            if (sec_idx != -1)
+              return fail("bounds on secondary item " + token);
+            if (!ParseBounds(token.substr(0, bar), &lo, &hi))
+              return fail("bad bounds on item " + token);
+            token = token.substr(bar + 1);
+            multiplicities = multiplicities || lo != 1 || hi != 1;
+          }
+          if (token.empty() || token.find(':') != std::string::npos ||
+              token.find('|') != std::string::npos)
+            return fail("bad item name " + token);
+          if (!item_idxs.emplace(token, items_.size()).second)
+            return fail("duplicate item " + token);
+          items_.push_back(token);
+          if (sec_idx == -1)
+            bounds.push_back({lo, hi});
+        }
+        if (sec_idx == -1)
+          sec_idx = items_.size();
+        continue;
+      }
+      // An option.
+      std::vector<int> cols, cols_colors;
+      while (tokens >> token) {
+        const size_t colon = token.find(':');
+        const auto it = item_idxs.find(token.substr(0, colon));
+        if (it == item_idxs.end())
+          return fail("unknown item " + token.substr(0, colon));
+        int color = 0;
+        if (colon != std::string::npos) {
+          if (it->second < sec_idx)
+            return fail("color on primary item " + token);
+          if (colon + 1 == token.size())
+            return fail("empty color in " + token);
+          color = color_idxs.emplace(token.substr(colon + 1),
+                                     color_idxs.size() + 1)
+                      .first->second;
+          colored = true;
+        }
+        cols.push_back(it->second);
+        cols_colors.push_back(color);
+      }
+      // Rows list their columns in increasing order.
+      std::vector<int> order(cols.size());
+      std::iota(order.begin(), order.end(), 0);
+      std::sort(order.begin(), order.end(),
+                [&cols](int a, int b) { return cols[a] < cols[b]; });
+      rows.emplace_back();
+      colors.emplace_back();
+      for (int k : order) {
+        if (!rows.back().empty() && rows.back().back() == cols[k])
+          return fail("item " + items_[cols[k]] + " repeated in option");
+        rows.back().push_back(cols[k]);
+        colors.back().push_back(cols_colors[k]);
+      }
+    }
+    if (sec_idx == -1) {
+      *error = "no items";
+      return false;
+    }
+    if (!colored)
+      colors.clear();
+    matrix_ = SparseMatrixFromVector(rows, items_.size(), sec_idx, colors);
+    if (multiplicities) {
+      for (int j = 0; j < sec_idx; j++)
+        matrix_.SetBounds(j, bounds[j].first, bounds[j].second);
+    }
+    return true;
+  }
+
+  // The instance read, as a matrix whose columns are the items in the
+  // order they were named.
+  SparseMatrixFromVector &Matrix() { return matrix_; }
+  const std::string &ItemName(int j) const { return items_[j]; }
+
+private:
+  // Parses "v" or "u:v" with 0 <= u <= v.
+  static bool ParseBounds(const std::string &text, int *lo, int *hi) {
+    std::istringstream in(text);
+    char colon;
+    if (!(in >> *hi))
+      return false;
+    *lo = *hi;
+    if (in >> colon && (colon != ':' || !(in >> *hi)))
+      return false;
+    return in.eof() && 0 <= *lo && *lo <= *hi;
+  }
+
+  std::vector<std::string> items_;
+  SparseMatrixFromVector matrix_{{}, 0, 0};
+};
+
+} // namespace dlx
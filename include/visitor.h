@@ -1,32 +1,112 @@
 #pragma once
 
 #include <iostream>
+#include <mutex>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "output.h"
+
 namespace dlx {
 
 // Interface class for visiting solutions (a subset of row
 // indices). Return value dictates whether to continue the
-// backtracking search.
+// backtracking search. Implementations declared final are called
+// without virtual dispatch by the templated DancingLinks::Solve(..).
 class VisitorInterface {
 public:
   virtual bool VisitSolution(const std::vector<int> &solution) = 0;
 };
 
-// Default implementation prints solution to stdout.
+// Reports a solution to any kind of visitor accepted by the templated
+// solvers: an implementation of VisitorInterface (calls on classes
+// declared final are resolved and inlined at compile time) or a
+// callable taking the solution and returning whether to continue, or
+// void to visit all solutions.
+template <class Visitor>
+bool VisitChosen(Visitor &visitor, const std::vector<int> &chosen) {
+  if constexpr (std::is_invocable_v<Visitor &, const std::vector<int> &>) {
+    if constexpr (std::is_void_v<
+                      std::invoke_result_t<Visitor &, const std::vector<int> &>>) {
+      visitor(chosen);
+      return true;
+    } else {
+      return visitor(chosen);
+    }
+  } else {
+    return visitor.VisitSolution(chosen);
+  }
+}
+
+// Visitors whose results must survive a checkpoint (see checkpoint.h)
+// define `void Save(std::ostream &) const` and `void Load(std::istream
+// &)` to write and read back their state. Others are assumed to be
+// stateless.
+template <class Visitor, class = void>
+struct HasCheckpointHooks : std::false_type {};
+template <class Visitor>
+struct HasCheckpointHooks<
+    Visitor, std::void_t<decltype(std::declval<const Visitor &>().Save(
+                             std::declval<std::ostream &>())),
+                         decltype(std::declval<Visitor &>().Load(
+                             std::declval<std::istream &>()))>>
+    : std::true_type {};
+
+// Default implementation prints solution to stdout through a buffer,
+// which is written out once it fills a block (OutputBuffer::kBlockSize
+// bytes), by Flush() or on destruction. Call Flush() before writing
+// anything else to stdout while the visitor is alive. The buffer makes
+// the visitor non-copyable.
 template <bool visit_all> class DefaultVisitor : public VisitorInterface {
 public:
   bool VisitSolution(const std::vector<int> &chosen) override {
-    std::cout << "[";
-    for (int i = 0; i < chosen.size(); i++)
-      std::cout << chosen[i] << (i != chosen.size() - 1 ? ", " : "");
-    std::cout << "]";
+    out_.Put('[');
+    for (size_t i = 0; i < chosen.size(); i++) {
+      out_.PutInt(chosen[i]);
+      if (i != chosen.size() - 1)
+        out_.Put(", ", 2);
+    }
+    out_.Put(']');
+    out_.EndRecord();
     return visit_all;
   }
+  void Flush() { out_.Flush(); }
+
+private:
+  OutputBuffer out_{&std::cout};
+};
+
+// Writes every solution to an OutputBuffer that is not owned, in the
+// text format of PutText(..).
+class TextSolutionWriter final : public VisitorInterface {
+public:
+  explicit TextSolutionWriter(OutputBuffer *out) : out_(out) {}
+  bool VisitSolution(const std::vector<int> &chosen) override {
+    PutText(chosen, out_);
+    return true;
+  }
+
+private:
+  OutputBuffer *out_;
+};
+
+// Same in the binary format of PutBinary(..), read back by
+// GetBinary(..).
+class BinarySolutionWriter final : public VisitorInterface {
+public:
+  explicit BinarySolutionWriter(OutputBuffer *out) : out_(out) {}
+  bool VisitSolution(const std::vector<int> &chosen) override {
+    PutBinary(chosen, out_);
+    return true;
+  }
+
+private:
+  OutputBuffer *out_;
 };
 
 // Saves the solutions to a vector that is not owned.
-class SavingVisitor : public VisitorInterface {
+class SavingVisitor final : public VisitorInterface {
 public:
   SavingVisitor() = delete;
   explicit SavingVisitor(std::vector<std::vector<int>> *ptr) : ptr_(ptr) {}
@@ -40,7 +120,7 @@ private:
 };
 
 // Just counts solutions.
-template <class T> class CountingVisitor : public VisitorInterface {
+template <class T> class CountingVisitor final : public VisitorInterface {
 public:
   CountingVisitor() : count_(0) {}
   bool VisitSolution(const std::vector<int> &chosen) override {
@@ -49,12 +129,16 @@ public:
   }
   T Count() const { return count_; }
 
+  // Checkpoint hooks.
+  void Save(std::ostream &out) const { out << count_; }
+  void Load(std::istream &in) { in >> count_; }
+
 private:
   T count_;
 };
 
 // Test uniqueness.
-class UniquenessTestingVisitor : public VisitorInterface {
+class UniquenessTestingVisitor final : public VisitorInterface {
 public:
   UniquenessTestingVisitor() : count_(0) {}
   bool VisitSolution(const std::vector<int> &chosen) override {
@@ -67,4 +151,20 @@ private:
   int count_;
 };
 
+// Serializes the calls to a visitor that is not owned, so that a
+// single visitor can be shared by the workers of a parallel solve.
+class SynchronizedVisitor : public VisitorInterface {
+public:
+  SynchronizedVisitor() = delete;
+  explicit SynchronizedVisitor(VisitorInterface *ptr) : ptr_(ptr) {}
+  bool VisitSolution(const std::vector<int> &chosen) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ptr_->VisitSolution(chosen);
+  }
+
+private:
+  VisitorInterface *ptr_;
+  std::mutex mutex_;
+};
+
 } // namespace dlx
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "visitor.h"
+
+namespace dlx {
+
+// Unsigned integer of arbitrary width, for counting solutions beyond
+// 2^64. Only what counting needs is supported.
+class BigUnsigned {
+public:
+  BigUnsigned(uint64_t value = 0) {
+    for (; value != 0; value >>= 32)
+      limbs_.push_back(uint32_t(value));
+  }
+  BigUnsigned &operator+=(const BigUnsigned &other) {
+    if (limbs_.size() < other.limbs_.size())
+      limbs_.resize(other.limbs_.size(), 0);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < limbs_.size(); i++) {
+      carry += uint64_t(limbs_[i]) +
+               (i < other.limbs_.size() ? other.limbs_[i] : 0);
+      limbs_[i] = uint32_t(carry);
+      carry >>= 32;
+    }
+    if (carry != 0)
+      limbs_.push_back(uint32_t(carry));
+    return *this;
+  }
+  bool operator==(const BigUnsigned &other) const {
+    return limbs_ == other.limbs_;
+  }
+  // Decimal representation.
+  std::string ToString() const {
+    std::vector<uint32_t> rest(limbs_);
+    std::string digits;
+    while (!rest.empty()) {
+      uint64_t rem = 0; // Divide by 10^9, least significant chunk first.
+      for (int i = rest.size() - 1; i >= 0; i--) {
+        uint64_t cur = (rem << 32) | rest[i];
+        rest[i] = uint32_t(cur / 1000000000);
+        rem = cur % 1000000000;
+      }
+      while (!rest.empty() && rest.back() == 0)
+        rest.pop_back();
+      for (int k = 0; k < 9 && (!rest.empty() || rem != 0); k++, rem /= 10)
+        digits.push_back('0' + rem % 10);
+    }
+    return digits.empty() ? "0" : std::string(digits.rbegin(), digits.rend());
+  }
+
+private:
+  std::vector<uint32_t> limbs_; // Least significant first.
+};
+
+// A zero-suppressed decision diagram (ZDD) representing a family of
+// solutions, as built by DancingLinks::ZddSolve(..). Every node other
+// than the two terminals is labeled with a row and stands for the
+// solutions of its `lo` child together with the solutions of its `hi`
+// child extended by the row. Nodes are unique and are only ever added
+// after their children, so node ids are in topological order.
+class Zdd {
+public:
+  static constexpr int kEmpty = 0; // The empty family.
+  static constexpr int kUnit = 1;  // The family of only the empty set.
+
+  Zdd() : nodes_{{-1, kEmpty, kEmpty}, {-1, kUnit, kUnit}} {}
+
+  // Returns the (unique) node for the given triple.
+  int Node(int row_idx, int lo, int hi) {
+    if (hi == kEmpty) // Zero-suppression rule.
+      return lo;
+    ZddNode node{row_idx, lo, hi};
+    auto it = unique_.find(node);
+    if (it != unique_.end())
+      return it->second;
+    nodes_.push_back(node);
+    return unique_[node] = nodes_.size() - 1;
+  }
+
+  int Size() const { return nodes_.size(); }
+
+  // Rows common to all the solutions (those selected on the solver).
+  void SetPrefix(const std::vector<int> &prefix) { prefix_ = prefix; }
+
+  // Number of solutions under `root`, in any type that can be built
+  // from 0 and 1 and supports += (e.g. uint64_t or BigUnsigned).
+  template <class T> T Count(int root) const {
+    std::vector<T> counts{T(0), T(1)};
+    counts.reserve(root + 1);
+    for (int id = 2; id <= root; id++) {
+      counts.push_back(counts[nodes_[id].lo]);
+      counts.back() += counts[nodes_[id].hi];
+    }
+    return counts[root];
+  }
+
+  // Visits the solutions under `root` in the order the search found
+  // them. Returns false if the visitor ended the enumeration.
+  bool Enumerate(int root, VisitorInterface &visitor) const {
+    std::vector<int> chosen{prefix_};
+    return Enumerate(root, visitor, &chosen);
+  }
+
+  // Draws a solution under `root` uniformly at random. The root must
+  // not be kEmpty.
+  template <class Generator>
+  std::vector<int> Sample(int root, Generator &gen) const {
+    std::vector<double> counts{0, 1};
+    for (int id = 2; id <= root; id++)
+      counts.push_back(counts[nodes_[id].lo] + counts[nodes_[id].hi]);
+    std::vector<int> chosen{prefix_};
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int id = root; id != kUnit;) {
+      const auto &node = nodes_[id];
+      if (uniform(gen) * counts[id] < counts[node.hi]) {
+        chosen.push_back(node.row_idx);
+        id = node.hi;
+      } else {
+        id = node.lo;
+      }
+    }
+    return chosen;
+  }
+
+private:
+  struct ZddNode {
+    int row_idx, lo, hi;
+    bool operator==(const ZddNode &other) const {
+      return row_idx == other.row_idx && lo == other.lo && hi == other.hi;
+    }
+  };
+  struct ZddNodeHash {
+    size_t operator()(const ZddNode &node) const {
+      return ((uint64_t(node.lo) << 32) | uint32_t(node.hi)) ^
+             (uint64_t(node.row_idx) * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+
+  bool Enumerate(int id, VisitorInterface &visitor,
+                 std::vector<int> *chosen) const {
+    if (id == kUnit)
+      return visitor.VisitSolution(*chosen);
+    if (id == kEmpty)
+      return true;
+    const auto &node = nodes_[id];
+    if (!Enumerate(node.lo, visitor, chosen))
+      return false;
+    chosen->push_back(node.row_idx);
+    bool should_continue = Enumerate(node.hi, visitor, chosen);
+    chosen->pop_back();
+    return should_continue;
+  }
+
+  std::vector<ZddNode> nodes_;
+  std::vector<int> prefix_;
+  std::unordered_map<ZddNode, int, ZddNodeHash> unique_;
+};
+
+} // namespace dlx
@@ -1,7 +1,20 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
 
 #include "dlx.h"
+#include "examples/nqueens.h"
 #include "examples/sudoku.h"
 
 void TEST_secondary_columns() {
@@ -19,6 +32,80 @@ void TEST_secondary_columns() {
   std::cout << "PASSED: TEST_secondary_columns." << std::endl;
 };
 
+void TEST_sparse_matrix() {
+  std::vector<std::vector<int>> rows{{0, 3}, {1, 2}, {0, 1, 2}, {3}, {}},
+      dense(rows.size(), std::vector<int>(4, 0));
+  for (size_t i = 0; i < rows.size(); i++)
+    for (int j : rows[i])
+      dense[i][j] = 1;
+  dlx::MatrixFromVector<int> dense_view(dense, 4);
+  dlx::SparseMatrixFromVector sparse_view(rows, 4, 4);
+  for (int i = 0; i < int(rows.size()); i++)
+    for (int j = 0; j < 4; j++)
+      assert(dense_view.Value(i, j) == sparse_view.Value(i, j));
+  std::vector<std::vector<int>> dense_solns, sparse_solns;
+  dlx::SavingVisitor dense_visitor{&dense_solns}, sparse_visitor{&sparse_solns};
+  dlx::DancingLinks<dlx::FirstAvailableColumn> dlx{dense_view};
+  dlx.Solve(dense_visitor);
+  dlx.Initialize(sparse_view);
+  dlx.Solve(sparse_visitor);
+  assert(dense_solns == sparse_solns);
+  assert(2 == sparse_solns.size());
+
+  // The native sparse generator must agree with the closed form Value(..).
+  SudokuMatrix sudoku_matrix{2};
+  std::vector<std::vector<int>> via_value, via_row;
+  dlx::SavingVisitor value_visitor{&via_value}, row_visitor{&via_row};
+  dlx.Initialize(static_cast<dlx::MatrixInterface &>(sudoku_matrix));
+  dlx.Solve(value_visitor);
+  dlx.Initialize(sudoku_matrix);
+  dlx.Solve(row_visitor);
+  assert(288 == via_row.size() && via_value == via_row);
+  std::cout << "PASSED: TEST_sparse_matrix." << std::endl;
+}
+
+void TEST_cell_layout() {
+  SudokuMatrix matrix{2};
+  std::vector<std::vector<int>> expected, narrow, column_major, wide;
+  dlx::SavingVisitor expected_visitor{&expected}, narrow_visitor{&narrow},
+      column_major_visitor{&column_major}, wide_visitor{&wide};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes>{matrix}.Solve(expected_visitor);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int16_t>{matrix}.Solve(
+      narrow_visitor);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int16_t>{
+      matrix, dlx::CellOrder::COLUMN_MAJOR}
+      .Solve(column_major_visitor, dlx::SolutionMethod::RECURSIVE);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int64_t>{matrix}.Solve(
+      wide_visitor);
+  assert(288 == expected.size());
+  assert(expected == narrow && expected == column_major && expected == wide);
+  std::cout << "PASSED: TEST_cell_layout." << std::endl;
+}
+
+void TEST_select_rows() {
+  std::vector<std::vector<int>> rows{{0, 3}, {1, 2}, {0, 1, 2}, {3}, {2}, {1}};
+  dlx::SparseMatrixFromVector mat_view(rows, 4, 4);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{mat_view};
+  auto count = [&dlx]() {
+    dlx::CountingVisitor<int> visitor;
+    dlx.Solve(visitor);
+    return visitor.Count();
+  };
+  assert(3 == count());
+  assert(dlx.SelectRow(3));
+  assert(!dlx.SelectRow(0)); // Conflicts with row 3.
+  assert(dlx.SelectRow(2));
+  std::vector<std::vector<int>> solns;
+  dlx::SavingVisitor visitor{&solns};
+  dlx.Solve(visitor, dlx::SolutionMethod::RECURSIVE);
+  assert(solns == std::vector<std::vector<int>>({{3, 2}}));
+  dlx.UnselectRow();
+  assert(1 == count());
+  dlx.UnselectAllRows();
+  assert(3 == count());
+  std::cout << "PASSED: TEST_select_rows." << std::endl;
+}
+
 void TEST_sudoku_2x2() {
   Sudoku<dlx::ColumnWithLeastOnes> sudoku{2};
   assert(sudoku.MoreThanOneSolution());
@@ -40,9 +127,1214 @@ void TEST_sudoku_3x3() {
   std::cout << "PASSED: TEST_sudoku_3x3." << std::endl;
 }
 
+void TEST_parallel_solve() {
+  NQueens<dlx::ColumnWithLeastOnes> nqueens{8};
+  assert(92 == nqueens.Count());
+  for (int threads : {1, 2, 5})
+    assert(92 == nqueens.ParallelCount(threads));
+  Sudoku<dlx::ColumnWithLeastOnes> blank{2};
+  assert(288 == blank.ParallelCount(3));
+
+  // A shared visitor sees exactly the serial solutions.
+  std::vector<std::vector<int>> rows;
+  for (int i = 0; i < 12; i++)
+    rows.push_back({i % 4, 4 + i % 3, 7 + (i * 5) % 6});
+  for (int j = 0; j < 13; j++)
+    rows.push_back({j});
+  dlx::SparseMatrixFromVector mat_view(rows, 13, 13);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{mat_view};
+  std::vector<std::vector<int>> serial, parallel;
+  dlx::SavingVisitor serial_visitor{&serial}, parallel_visitor{&parallel};
+  dlx::SynchronizedVisitor shared{&parallel_visitor};
+  dlx.Solve(serial_visitor);
+  dlx.ParallelSolve({&shared, &shared, &shared, &shared});
+  for (auto *solns : {&serial, &parallel}) {
+    for (auto &soln : *solns)
+      std::sort(soln.begin(), soln.end());
+    std::sort(solns->begin(), solns->end());
+  }
+  assert(serial.size() > 1 && serial == parallel);
+  std::cout << "PASSED: TEST_parallel_solve." << std::endl;
+}
+
+void TEST_batch_solver() {
+  // Count the completions of partial 4x4 grids against one base matrix.
+  using Solver = dlx::DancingLinks<dlx::ColumnWithLeastOnes>;
+  SudokuMatrix matrix{2};
+  Solver prototype{matrix};
+  std::vector<std::vector<int>> jobs;
+  for (int k = 0; k < 40; k++)
+    jobs.push_back({(k * 7) % 64, (k * 13 + 5) % 64, (k * 5 + 11) % 64});
+  auto solve = [](const std::vector<int> &rows, Solver &dlx) {
+    int selected = 0;
+    bool consistent = true;
+    for (int row_idx : rows) {
+      consistent = consistent && dlx.SelectRow(row_idx);
+      selected += consistent;
+    }
+    dlx::CountingVisitor<int> visitor;
+    if (consistent)
+      dlx.Solve(visitor);
+    for (; selected > 0; selected--)
+      dlx.UnselectRow();
+    return visitor.Count();
+  };
+  std::vector<int> serial, batched;
+  for (const auto &rows : jobs)
+    serial.push_back(solve(rows, prototype));
+  dlx::BatchSolver<Solver, std::vector<int>, int> batch{prototype, 3};
+  auto next = jobs.begin();
+  auto stats = batch.Run(
+      [&](std::vector<int> *rows) {
+        if (next == jobs.end())
+          return false;
+        *rows = *next++;
+        return true;
+      },
+      solve, [&](int &&count) { batched.push_back(count); });
+  assert(40 == stats.instances);
+  assert(serial == batched);
+  std::cout << "PASSED: TEST_batch_solver." << std::endl;
+}
+
+void TEST_zdd() {
+  SudokuMatrix matrix{2};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{matrix};
+  dlx::Zdd zdd;
+  int root = dlx.ZddSolve(&zdd);
+  assert(288 == zdd.Count<uint64_t>(root));
+  assert("288" == zdd.Count<dlx::BigUnsigned>(root).ToString());
+  std::vector<std::vector<int>> searched, enumerated;
+  dlx::SavingVisitor search_visitor{&searched}, zdd_visitor{&enumerated};
+  dlx.Solve(search_visitor);
+  zdd.Enumerate(root, zdd_visitor);
+  assert(searched == enumerated);
+  std::mt19937 gen(42);
+  auto sample = zdd.Sample(root, gen);
+  assert(std::find(searched.begin(), searched.end(), sample) != searched.end());
+
+  // Selected rows are part of every solution.
+  assert(dlx.SelectRow(5));
+  root = dlx.ZddSolve(&zdd);
+  assert(dlx.SelectedRows()[0] == zdd.Sample(root, gen)[0]);
+  dlx.UnselectRow();
+
+  NQueensMatrix queens{8};
+  dlx.Initialize(queens);
+  assert(92 == zdd.Count<int>(dlx.ZddSolve(&zdd)));
+
+  dlx::BigUnsigned big(uint64_t(1) << 63);
+  big += big;
+  assert("18446744073709551616" == big.ToString());
+  std::cout << "PASSED: TEST_zdd." << std::endl;
+}
+
+void TEST_bucketed_policy() {
+  // A hard puzzle with one clue removed has 794 solutions.
+  std::string puzzle("4.....8.5.3..........7......2.....6.....8"
+                     "........1.......6.3.7.5..2.....1.4......");
+  SudokuMatrix sudoku{3};
+  NQueensMatrix queens{8};
+  for (dlx::SparseMatrixInterface *matrix :
+       std::vector<dlx::SparseMatrixInterface *>{&sudoku, &queens}) {
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> scanning{*matrix};
+    dlx::DancingLinks<dlx::BucketedColumnWithLeastOnes> bucketed{*matrix};
+    if (matrix == &sudoku) {
+      for (int pos = 0; pos < 81; pos++) {
+        if (puzzle[pos] == '.')
+          continue;
+        int row_idx = (pos % 9) * 81 + (pos / 9) * 9 + (puzzle[pos] - '1');
+        assert(scanning.SelectRow(row_idx) && bucketed.SelectRow(row_idx));
+      }
+    }
+    for (auto method :
+         {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+      std::vector<std::vector<int>> expected, solns;
+      dlx::SavingVisitor expected_visitor{&expected}, visitor{&solns};
+      scanning.Solve(expected_visitor, method);
+      bucketed.Solve(visitor, method);
+      for (auto *all : {&expected, &solns})
+        for (auto &soln : *all)
+          std::sort(soln.begin(), soln.end());
+      assert(expected.size() > 1 && expected == solns);
+    }
+  }
+  Sudoku<dlx::BucketedColumnWithLeastOnes> blank{2};
+  assert(288 == blank.Count() && 288 == blank.ParallelCount(2));
+  std::cout << "PASSED: TEST_bucketed_policy." << std::endl;
+}
+
+void TEST_static_visitors() {
+  NQueensMatrix queens{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{queens};
+  int count = 0;
+  dlx.Solve([&count](const std::vector<int> &) { count++; });
+  assert(92 == count);
+  std::vector<std::vector<int>> solns, first;
+  dlx::SavingVisitor visitor{&solns};
+  dlx.Solve(static_cast<dlx::VisitorInterface &>(visitor),
+            dlx::SolutionMethod::RECURSIVE);
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    first.clear();
+    dlx.Solve(
+        [&first](const std::vector<int> &chosen) {
+          first.push_back(chosen);
+          return first.size() < 3;
+        },
+        method);
+    assert(std::vector<std::vector<int>>(solns.begin(), solns.begin() + 3) ==
+           first);
+  }
+  dlx::CountingVisitor<int> counter;
+  dlx.Solve(counter);
+  assert(92 == counter.Count());
+  std::cout << "PASSED: TEST_static_visitors." << std::endl;
+}
+
+void TEST_search_stats() {
+  // Two singleton rows per column: a complete binary tree of depth 3.
+  std::vector<std::vector<int>> rows{{0}, {0}, {1}, {1}, {2}, {2}};
+  dlx::SparseMatrixFromVector mat_view(rows, 3, 3);
+  dlx::DancingLinks<dlx::FirstAvailableColumn, int, dlx::SearchStats> dlx{
+      mat_view};
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    dlx::CountingVisitor<int> visitor;
+    dlx.Solve(visitor, method);
+    const auto &stats = dlx.Stats();
+    assert(15 == stats.nodes && 8 == stats.solutions);
+    assert(std::vector<long>({1, 2, 4, 8}) == stats.nodes_per_depth);
+    assert(std::vector<long>({2, 4, 8, 0}) == stats.branches_per_depth);
+    assert(7 == stats.covers && 7 == stats.uncovers && 14 == stats.updates);
+    assert(stats.seconds_to_first_solution >= 0);
+  }
+
+  // Rows committed by propagation are not depths of either method.
+  NQueensMatrix queens{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> nqueens{
+      queens};
+  nqueens.SetPropagation(dlx::Propagation::SINGLETONS);
+  std::vector<dlx::SearchStats> profiles;
+  for (auto method :
+       {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+    nqueens.Solve(dlx::CountingVisitor<int>{}, method);
+    profiles.push_back(nqueens.Stats());
+  }
+  assert(profiles[0].forced > 0 && profiles[0].nodes == profiles[1].nodes);
+  assert(profiles[0].nodes_per_depth == profiles[1].nodes_per_depth);
+  assert(profiles[0].branches_per_depth == profiles[1].branches_per_depth);
+  std::cout << "PASSED: TEST_search_stats." << std::endl;
+}
+
+void TEST_colored_columns() {
+  // Knuth's example for Algorithm C, with primary columns p, q, r and
+  // secondary columns x, y, plus two rows to share x in color A (1).
+  std::vector<std::vector<int>> rows{{0, 1, 3, 4}, {0, 2, 3, 4}, {0, 3}, {1, 3},
+                                     {2, 4},       {2, 3},       {0}},
+      colors{{0, 0, 0, 1}, {0, 0, 1, 0}, {0, 2}, {0, 1}, {0, 2}, {0, 1}, {0}};
+  dlx::SparseMatrixFromVector mat_view(rows, 5, 3, colors);
+  std::vector<std::vector<int>> ans{{1, 3}, {3, 4, 6}, {3, 5, 6}};
+  for (int k = 0; k < 3; k++) {
+    dlx::DancingLinks<dlx::FirstAvailableColumn> dlx;
+    if (k == 0)
+      dlx.Initialize(static_cast<dlx::MatrixInterface &>(mat_view));
+    else
+      dlx.Initialize(mat_view, k == 1 ? dlx::CellOrder::ROW_MAJOR
+                                      : dlx::CellOrder::COLUMN_MAJOR);
+    for (auto method :
+         {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+      std::vector<std::vector<int>> solns;
+      dlx::SavingVisitor visitor{&solns};
+      dlx.Solve(visitor, method);
+      for (auto &soln : solns)
+        std::sort(soln.begin(), soln.end());
+      std::sort(solns.begin(), solns.end());
+      assert(ans == solns);
+    }
+    dlx::Zdd zdd;
+    assert(3 == zdd.Count<int>(dlx.ZddSolve(&zdd)));
+
+    // x is taken in color B (2), so rows with x in A must be rejected.
+    assert(dlx.SelectRow(2) && !dlx.SelectRow(3) && !dlx.SelectRow(5));
+    dlx::CountingVisitor<int> counter;
+    dlx.Solve(counter);
+    assert(0 == counter.Count());
+    dlx.UnselectRow();
+    assert(dlx.SelectRow(5) && dlx.SelectRow(3) && !dlx.SelectRow(0));
+    dlx.Solve(counter);
+    assert(1 == counter.Count());
+    dlx.UnselectAllRows();
+  }
+  std::cout << "PASSED: TEST_colored_columns." << std::endl;
+}
+
+// Distinct solutions of the instance in which column j must be covered
+// between lo[j] and hi[j] times, through the classic encoding: column
+// j becomes hi[j] columns, each row is repeated for every choice of
+// one of those per column, and the last hi[j] - lo[j] of them can be
+// filled by extra singleton rows instead. A secondary column per row
+// keeps its copies from sharing a solution.
+std::set<std::vector<int>> ExpandedSolutions(
+    const std::vector<std::vector<int>> &rows, const std::vector<int> &lo,
+    const std::vector<int> &hi) {
+  std::vector<int> first(lo.size());
+  int ncols = 0;
+  for (size_t j = 0; j < lo.size(); j++) {
+    first[j] = ncols;
+    ncols += hi[j];
+  }
+  std::vector<std::vector<int>> expanded;
+  std::vector<int> origin; // Row of each copy, or -1 for the fillers.
+  for (int i = 0; i < int(rows.size()); i++) {
+    std::vector<std::vector<int>> variants{{}};
+    for (int j : rows[i]) {
+      std::vector<std::vector<int>> next;
+      for (const auto &variant : variants) {
+        for (int k = 0; k < hi[j]; k++) {
+          next.push_back(variant);
+          next.back().push_back(first[j] + k);
+        }
+      }
+      variants.swap(next);
+    }
+    for (auto &variant : variants) {
+      variant.push_back(ncols + i);
+      expanded.push_back(variant);
+      origin.push_back(i);
+    }
+  }
+  for (size_t j = 0; j < lo.size(); j++) {
+    for (int k = lo[j]; k < hi[j]; k++) {
+      expanded.push_back({first[j] + k});
+      origin.push_back(-1);
+    }
+  }
+  dlx::SparseMatrixFromVector mat_view(expanded, ncols + rows.size(), ncols);
+  dlx::DancingLinks<> dlx{mat_view};
+  std::set<std::vector<int>> solns;
+  dlx.Solve([&](const std::vector<int> &chosen) {
+    std::vector<int> soln;
+    for (int row_idx : chosen)
+      if (origin[row_idx] != -1)
+        soln.push_back(origin[row_idx]);
+    std::sort(soln.begin(), soln.end());
+    solns.insert(soln);
+  });
+  return solns;
+}
+
+template <class ColumnPickingPolicy>
+std::vector<std::vector<int>>
+MultiplicitySolutions(dlx::SparseMatrixFromVector &mat_view) {
+  dlx::DancingLinks<ColumnPickingPolicy> dlx{mat_view};
+  std::vector<std::vector<int>> solns;
+  dlx.Solve([&](const std::vector<int> &chosen) {
+    solns.push_back(chosen);
+    std::sort(solns.back().begin(), solns.back().end());
+  });
+  std::sort(solns.begin(), solns.end());
+  return solns;
+}
+
+void TEST_multiplicities() {
+  std::mt19937 gen(13);
+  std::uniform_int_distribution<int> coin(0, 2);
+  for (int instance = 0; instance < 100; instance++) {
+    const int ncols = 4;
+    std::vector<std::vector<int>> rows(9);
+    for (auto &row : rows)
+      for (int j = 0; j < ncols; j++)
+        if (coin(gen) == 0)
+          row.push_back(j);
+    std::vector<int> lo(ncols), hi(ncols);
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, ncols);
+    for (int j = 0; j < ncols; j++) {
+      lo[j] = coin(gen);
+      hi[j] = lo[j] + coin(gen);
+      mat_view.SetBounds(j, lo[j], hi[j]);
+    }
+    const auto expected = ExpandedSolutions(rows, lo, hi);
+    for (const auto &solns :
+         {MultiplicitySolutions<dlx::ColumnWithLeastOnes>(mat_view),
+          MultiplicitySolutions<dlx::BucketedColumnWithLeastOnes>(mat_view),
+          MultiplicitySolutions<dlx::LastAvailableColumn>(mat_view)}) {
+      // Every solution is found exactly once.
+      assert(std::adjacent_find(solns.begin(), solns.end()) == solns.end());
+      assert(std::vector<std::vector<int>>(expected.begin(), expected.end()) ==
+             solns);
+    }
+  }
+
+  // A column that may be left empty has one more branch than ones.
+  std::vector<std::vector<int>> rows{{0, 1}, {0}, {0, 1}};
+  dlx::SparseMatrixFromVector mat_view(rows, 2, 2);
+  mat_view.SetBounds(0, 0, 2);
+  assert((MultiplicitySolutions<dlx::ColumnWithLeastOnes>(mat_view) ==
+          MultiplicitySolutions<dlx::BucketedColumnWithLeastOnes>(mat_view)));
+  std::cout << "PASSED: TEST_multiplicities." << std::endl;
+}
+
+template <template <class, class, class> class Engine, class ColumnPickingPolicy>
+std::vector<std::vector<int>> EngineSolutions(dlx::SparseMatrixFromVector &mat_view,
+                                              dlx::SolutionMethod method) {
+  Engine<ColumnPickingPolicy, int, dlx::NoStats> engine{mat_view};
+  std::vector<std::vector<int>> solns;
+  engine.Solve(dlx::SavingVisitor{&solns}, method);
+  for (auto &soln : solns)
+    std::sort(soln.begin(), soln.end());
+  std::sort(solns.begin(), solns.end());
+  return solns;
+}
+
+void TEST_dancing_cells() {
+  std::mt19937 gen(14);
+  std::uniform_int_distribution<int> coin(0, 3);
+  for (int instance = 0; instance < 100; instance++) {
+    const int ncols = 6, sec_col = 4;
+    std::vector<std::vector<int>> rows(12);
+    for (auto &row : rows)
+      for (int j = 0; j < ncols; j++)
+        if (coin(gen) == 0)
+          row.push_back(j);
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, sec_col);
+    for (auto method :
+         {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+      const auto expected =
+          EngineSolutions<dlx::DancingLinks, dlx::ColumnWithLeastOnes>(mat_view,
+                                                                      method);
+      assert((expected == EngineSolutions<dlx::DancingCells,
+                                          dlx::ColumnWithLeastOnes>(mat_view,
+                                                                    method)));
+      assert((expected ==
+              EngineSolutions<dlx::DancingCells,
+                              dlx::BucketedColumnWithLeastOnes>(mat_view,
+                                                                method)));
+      assert((expected ==
+              EngineSolutions<dlx::DancingCells, dlx::FirstAvailableColumn>(
+                  mat_view, method)));
+      assert((expected ==
+              EngineSolutions<dlx::DancingCells, dlx::LastAvailableColumn>(
+                  mat_view, method)));
+      assert((expected ==
+              EngineSolutions<dlx::DancingCells, dlx::UniformlyRandomColumn>(
+                  mat_view, method)));
+    }
+  }
+
+  // Same columns picked, so the same search tree as DancingLinks.
+  NQueensMatrix queens{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> links{
+      queens};
+  dlx::DancingCells<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> cells{
+      queens};
+  links.Solve(dlx::CountingVisitor<int>{});
+  cells.Solve(dlx::CountingVisitor<int>{});
+  assert(92 == cells.Stats().solutions);
+  assert(links.Stats().nodes == cells.Stats().nodes);
+
+  Sudoku<dlx::ColumnWithLeastOnes, int, dlx::NoStats, dlx::DancingCells>
+      sudoku{3};
+  std::string non_unique(".....6....59.....82....8....45........3........6..3."
+                         "54...325..6..................");
+  assert(sudoku.SetProblem(non_unique));
+  assert(sudoku.MoreThanOneSolution());
+
+  // Colors and bounds are refused, leaving an instance without
+  // solutions, rather than ignored.
+  std::vector<std::vector<int>> rows{{0, 1}, {1}, {0}},
+      colors{{0, 1}, {2}, {0}};
+  dlx::SparseMatrixFromVector colored(rows, 2, 1, colors),
+      bounded(rows, 2, 2), plain(rows, 2, 2);
+  bounded.SetBounds(1, 0, 2);
+  for (auto *matrix : {&colored, &bounded, &plain}) {
+    dlx::DancingCells<dlx::ColumnWithLeastOnes> dense, sparse;
+    const bool supported = matrix == &plain;
+    assert(supported ==
+           dense.Initialize(static_cast<dlx::MatrixInterface &>(*matrix)));
+    assert(supported == sparse.Initialize(*matrix));
+    for (auto *engine : {&dense, &sparse}) {
+      int count = 0;
+      engine->Solve([&](const std::vector<int> &) { count++; });
+      assert(count == (supported ? 2 : 0)); // {0} and {1, 2}.
+    }
+  }
+  std::cout << "PASSED: TEST_dancing_cells." << std::endl;
+}
+
+void TEST_bitset_engine() {
+  std::mt19937 gen(15);
+  std::uniform_int_distribution<int> coin(0, 3);
+  for (int instance = 0; instance < 20; instance++) {
+    // Enough rows for two words per column.
+    const int ncols = 9, sec_col = 7;
+    std::vector<std::vector<int>> rows(80);
+    for (auto &row : rows)
+      for (int j = 0; j < ncols; j++)
+        if (coin(gen) == 0)
+          row.push_back(j);
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, sec_col);
+    for (auto method :
+         {dlx::SolutionMethod::ITERATIVE, dlx::SolutionMethod::RECURSIVE}) {
+      const auto expected =
+          EngineSolutions<dlx::DancingLinks, dlx::ColumnWithLeastOnes>(mat_view,
+                                                                      method);
+      assert((expected == EngineSolutions<dlx::BitsetEngine,
+                                          dlx::ColumnWithLeastOnes>(mat_view,
+                                                                    method)));
+      assert((expected ==
+              EngineSolutions<dlx::BitsetEngine,
+                              dlx::BucketedColumnWithLeastOnes>(mat_view,
+                                                                method)));
+      assert((expected ==
+              EngineSolutions<dlx::BitsetEngine, dlx::FirstAvailableColumn>(
+                  mat_view, method)));
+      assert((expected ==
+              EngineSolutions<dlx::BitsetEngine, dlx::LastAvailableColumn>(
+                  mat_view, method)));
+      assert((expected ==
+              EngineSolutions<dlx::BitsetEngine, dlx::UniformlyRandomColumn>(
+                  mat_view, method)));
+    }
+  }
+
+  // Same columns picked, so the same search tree as DancingLinks.
+  NQueensMatrix queens{9};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> links{
+      queens};
+  dlx::BitsetEngine<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> bits{
+      queens};
+  links.Solve(dlx::CountingVisitor<int>{});
+  bits.Solve(dlx::CountingVisitor<int>{}, dlx::SolutionMethod::RECURSIVE);
+  assert(352 == bits.Stats().solutions);
+  assert(links.Stats().nodes == bits.Stats().nodes);
+
+  std::vector<std::vector<int>> select_rows{{0, 3}, {1, 2}, {0, 1, 2},
+                                            {3},    {2},    {1}};
+  dlx::SparseMatrixFromVector select_view(select_rows, 4, 4);
+  dlx::BitsetEngine<> engine{select_view};
+  assert(engine.SelectRow(3));
+  assert(!engine.SelectRow(0)); // Conflicts with row 3.
+  assert(engine.SelectRow(2));
+  std::vector<std::vector<int>> solns;
+  engine.Solve(dlx::SavingVisitor{&solns});
+  assert(solns == std::vector<std::vector<int>>({{3, 2}}));
+  engine.UnselectAllRows();
+  dlx::CountingVisitor<int> counter;
+  engine.Solve(counter);
+  assert(3 == counter.Count());
+
+  // A 9x9 sudoku fits, a 16x16 one is left to DancingLinks.
+  SudokuMatrix sudoku9{3}, sudoku16{4};
+  assert(dlx::AdaptiveSolver<>{sudoku9}.UsesBitsets());
+  assert(!dlx::AdaptiveSolver<>{sudoku16}.UsesBitsets());
+  Sudoku<dlx::ColumnWithLeastOnes, int, dlx::NoStats, dlx::AdaptiveSolver>
+      sudoku{3};
+  std::string non_unique(".....6....59.....82....8....45........3........6..3."
+                         "54...325..6..................");
+  assert(sudoku.SetProblem(non_unique));
+  assert(sudoku.MoreThanOneSolution());
+  // Colors are left to DancingLinks too.
+  std::vector<std::vector<int>> colored_rows{{0, 1}, {1}};
+  dlx::SparseMatrixFromVector colored_view(colored_rows, 2, 1, {{0, 1}, {2}});
+  assert(!dlx::AdaptiveSolver<>{colored_view}.UsesBitsets());
+  // BitsetEngine itself refuses them, and bounds too.
+  dlx::SparseMatrixFromVector bounded_view(colored_rows, 2, 2);
+  bounded_view.SetBounds(0, 0, 1);
+  for (auto *matrix : {&colored_view, &bounded_view}) {
+    dlx::BitsetEngine<dlx::ColumnWithLeastOnes> dense, sparse;
+    assert(!dense.Initialize(static_cast<dlx::MatrixInterface &>(*matrix)));
+    assert(!sparse.Initialize(*matrix));
+    for (auto *refused : {&dense, &sparse}) {
+      int count = 0;
+      refused->Solve([&](const std::vector<int> &) { count++; });
+      assert(count == 0);
+    }
+  }
+  std::cout << "PASSED: TEST_bitset_engine." << std::endl;
+}
+
+void TEST_solution_iterator() {
+  NQueensMatrix queens6{6}, queens8{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx6{queens6}, dlx8{queens8};
+  std::vector<std::vector<int>> solns6, solns8;
+  dlx6.Solve(dlx::SavingVisitor{&solns6});
+  dlx8.Solve(dlx::SavingVisitor{&solns8});
+
+  // Two searches interleaved on this thread, in the order of Solve(..).
+  {
+    auto it6 = dlx6.Solutions();
+    auto it8 = dlx8.Solutions();
+    std::vector<std::vector<int>> pulled6, pulled8;
+    const std::vector<int> *soln6, *soln8;
+    do {
+      soln6 = it6.Next();
+      soln8 = it8.Next();
+      if (soln6 != nullptr)
+        pulled6.push_back(*soln6);
+      if (soln8 != nullptr)
+        pulled8.push_back(*soln8);
+    } while (soln6 != nullptr || soln8 != nullptr);
+    assert(pulled6 == solns6 && pulled8 == solns8);
+    assert(it8.Next() == nullptr);
+  }
+
+  // Abandoned early, with a selected row.
+  assert(dlx8.SelectRow(solns8[5][0]));
+  {
+    auto it = dlx8.Solutions();
+    for (int k = 0; k < 3; k++) {
+      const std::vector<int> *soln = it.Next();
+      assert(soln != nullptr && soln->front() == solns8[5][0]);
+    }
+  }
+  dlx8.UnselectAllRows();
+  dlx::CountingVisitor<int> counter;
+  dlx8.Solve(counter);
+  assert(92 == counter.Count());
+  std::cout << "PASSED: TEST_solution_iterator." << std::endl;
+}
+
+// Counts solutions, and throws after `limit` of them to simulate a
+// crash.
+class CrashingCounter {
+public:
+  explicit CrashingCounter(long limit) : limit_(limit) {}
+  bool operator()(const std::vector<int> &solution) {
+    if (++count_ == limit_)
+      throw std::runtime_error("crash");
+    return true;
+  }
+  long Count() const { return count_; }
+  void Save(std::ostream &out) const { out << count_; }
+  void Load(std::istream &in) { in >> count_; }
+
+private:
+  long count_ = 0, limit_;
+};
+
+void TEST_checkpoint() {
+  const std::string path = "/tmp/dlx_test_checkpoint";
+  NQueensMatrix queens8{8};
+  std::vector<std::vector<int>> solns, resumed;
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{queens8};
+  dlx.Solve(dlx::SavingVisitor{&solns});
+
+  // Through a file, into a fresh instance.
+  {
+    auto it = dlx.Solutions();
+    for (int k = 0; k < 40; k++)
+      resumed.push_back(*it.Next());
+    dlx::Checkpoint checkpoint;
+    it.Save(&checkpoint);
+    assert(checkpoint.Write(path));
+  }
+  {
+    dlx::Checkpoint checkpoint;
+    assert(checkpoint.Read(path));
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> fresh{queens8};
+    auto it = fresh.Solutions(checkpoint);
+    while (const std::vector<int> *soln = it.Next())
+      resumed.push_back(*soln);
+  }
+  assert(resumed == solns);
+
+  // Interrupted in the middle of CheckpointedSolve(..), checkpointing at
+  // every pause, and run again to completion.
+  std::remove(path.c_str());
+  NQueensMatrix queens12{12};
+  {
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> crashing{queens12};
+    CrashingCounter counter{10000};
+    try {
+      crashing.CheckpointedSolve(counter, path, 0);
+      assert(false);
+    } catch (const std::runtime_error &) {
+    }
+  }
+  dlx::Checkpoint checkpoint;
+  assert(checkpoint.Read(path) && !checkpoint.columns.empty());
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx12{queens12};
+  CrashingCounter counter{-1};
+  dlx12.CheckpointedSolve(counter, path, 0);
+  assert(14200 == counter.Count());
+  assert(!checkpoint.Read(path)); // Removed once done.
+  std::cout << "PASSED: TEST_checkpoint." << std::endl;
+}
+
+void TEST_random_policy() {
+  std::vector<long> luby;
+  for (int run = 0; run < 15; run++)
+    luby.push_back(dlx::RestartBudget(dlx::RestartSchedule::LUBY, run));
+  assert(luby == std::vector<long>({1, 1, 2, 1, 1, 2, 4, 1, 1, 2, 1, 1, 2, 4,
+                                    8}));
+  assert(8 == dlx::RestartBudget(dlx::RestartSchedule::GEOMETRIC, 3));
+
+  // Reproducible from the seed, on every engine.
+  NQueensMatrix queens8{8};
+  auto solutions = [&](auto &solver, uint32_t seed) {
+    std::vector<std::vector<int>> solns;
+    solver.Seed(seed);
+    solver.Solve(dlx::SavingVisitor{&solns});
+    return solns;
+  };
+  dlx::DancingLinks<dlx::UniformlyRandomColumn> links1{queens8},
+      links2{queens8};
+  dlx::DancingCells<dlx::UniformlyRandomColumn> cells1{queens8},
+      cells2{queens8};
+  dlx::BitsetEngine<dlx::UniformlyRandomColumn> bits1{queens8}, bits2{queens8};
+  auto solns = solutions(links1, 7);
+  assert(92 == solns.size() && solns == solutions(links2, 7));
+  assert(solns != solutions(links2, 8));
+  assert(solutions(cells1, 7) == solutions(cells2, 7));
+  assert(solutions(bits1, 7) == solutions(bits2, 7));
+
+  // Restarts find a placement of 30 queens, or prove there is none.
+  auto valid = [](int n, const std::vector<int> &queens) {
+    std::set<int> lines;
+    for (int row_idx : queens) {
+      int x = row_idx / n, y = row_idx % n;
+      lines.insert({x, n + y, 2 * n + x + y, 6 * n + y - x});
+    }
+    return int(queens.size()) == n && int(lines.size()) == 4 * n;
+  };
+  NQueensMatrix queens30{30}, queens3{3};
+  dlx::DancingLinks<dlx::UniformlyRandomColumn> dlx30{queens30}, dlx3{queens3};
+  std::vector<std::vector<int>> found;
+  for (auto schedule :
+       {dlx::RestartSchedule::LUBY, dlx::RestartSchedule::GEOMETRIC}) {
+    found.clear();
+    assert(dlx30.RestartSolve(dlx::SavingVisitor{&found}, 100, schedule));
+    assert(1 == found.size() && valid(30, found[0]));
+    assert(!dlx3.RestartSolve(dlx::SavingVisitor{&found}, 1, schedule));
+  }
+  std::cout << "PASSED: TEST_random_policy." << std::endl;
+}
+
+void TEST_output_sinks() {
+  std::vector<std::vector<int>> rows{{0, 3}, {1, 2}, {0, 1, 2}, {3}, {2}, {1}};
+  dlx::SparseMatrixFromVector mat_view(rows, 4, 4);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{mat_view};
+  std::ostringstream text;
+  {
+    dlx::OutputBuffer out{&text};
+    dlx.Solve(dlx::TextSolutionWriter{&out});
+  }
+  assert(text.str() == "0 1\n0 5 4\n2 3\n");
+
+  // Round trip through a file descriptor, with rows out of order and
+  // rows needing several bytes.
+  std::vector<std::vector<int>> solns{{5, 3, 1 << 30}, {}, {0, 127, 128, 7}};
+  for (int k = 0; k < 20000; k++) // More than a block.
+    solns.push_back({k, k + 1, k / 2});
+  const std::string path = "/tmp/dlx_test_output";
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  assert(fd >= 0);
+  {
+    dlx::OutputBuffer out{fd};
+    dlx::BinarySolutionWriter writer{&out};
+    for (const auto &soln : solns)
+      writer.VisitSolution(soln);
+    out.Flush();
+    assert(!out.Failed());
+  }
+  close(fd);
+  std::ifstream in(path, std::ios::binary);
+  std::vector<std::vector<int>> read;
+  for (std::vector<int> soln; dlx::GetBinary(in, &soln);)
+    read.push_back(soln);
+  assert(read == solns);
+  std::remove(path.c_str());
+
+  // DefaultVisitor holds its output until flushed.
+  std::ostringstream printed;
+  std::streambuf *stdout_buf = std::cout.rdbuf(printed.rdbuf());
+  {
+    dlx::DefaultVisitor<true> visitor;
+    visitor.VisitSolution({0, 5, 4});
+    assert(printed.str().empty());
+    visitor.Flush();
+    std::cout << "|";
+    visitor.VisitSolution({2, 3});
+  }
+  std::cout.rdbuf(stdout_buf);
+  assert(printed.str() == "[0, 5, 4]|[2, 3]");
+  std::cout << "PASSED: TEST_output_sinks." << std::endl;
+}
+
+void TEST_file_formats() {
+  // Knuth's example, with a comment, items listed out of order and a
+  // colored secondary item.
+  std::istringstream in("| Knuth's example\n"
+                        "a b c d e f g | x\n"
+                        "c e\n"
+                        "a g d\n"
+                        "b c f x:red\n"
+                        "\n"
+                        "a d f\n"
+                        "b g x:red\n"
+                        "d e g\n");
+  dlx::TextInstance text;
+  std::string error;
+  assert(text.Read(in, &error));
+  assert(text.Matrix().Rows() == 6 && text.Matrix().Cols() == 8);
+  assert(text.Matrix().FirstSecondaryColumnIndex() == 7);
+  assert(text.ItemName(7) == "x");
+  std::vector<std::vector<int>> solns;
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{text.Matrix()};
+  dlx.Solve(dlx::SavingVisitor{&solns});
+  assert(solns == std::vector<std::vector<int>>({{3, 4, 0}}));
+
+  std::istringstream bad("a b\na c\n");
+  assert(!text.Read(bad, &error) && error == "line 2: unknown item c");
+  std::istringstream bounds("2:1|a b\n");
+  assert(!text.Read(bounds, &error) &&
+         error == "line 1: bad bounds on item 2:1|a");
+
+  // The arena of 8 queens, with multiplicities on the rows and columns
+  // (2 to 3 queens each) for MSolve(..), saved and mapped back.
+  NQueensMatrix queens{8};
+  std::vector<std::vector<int>> rows(queens.Rows());
+  for (int i = 0; i < queens.Rows(); i++)
+    queens.Row(i, &rows[i]);
+  for (bool multiplicities : {false, true}) {
+    dlx::SparseMatrixFromVector matrix(rows, queens.Cols(),
+                                       queens.FirstSecondaryColumnIndex());
+    if (multiplicities) {
+      for (int j = 0; j < 16; j++)
+        matrix.SetBounds(j, 2, 3);
+    }
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> built{matrix};
+    std::vector<std::vector<int>> expected;
+    built.Solve(dlx::SavingVisitor{&expected});
+    const std::string path = "/tmp/dlx_test_arena";
+    assert(built.SaveArena(path));
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes, int64_t> wide;
+    assert(!wide.LoadArena(path)); // Written for another Index type.
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> mapped;
+    assert(mapped.LoadArena(path));
+    std::remove(path.c_str()); // The mapping outlives the file.
+    for (int pass = 0; pass < 2; pass++) {
+      solns.clear();
+      mapped.Solve(dlx::SavingVisitor{&solns});
+      assert(solns == expected);
+    }
+    if (!multiplicities) {
+      assert(expected.size() == 92);
+      dlx::DancingLinks<dlx::ColumnWithLeastOnes> copy{mapped};
+      assert(copy.SelectRow(0));
+      solns.clear();
+      copy.Solve(dlx::SavingVisitor{&solns});
+      assert(solns.size() == 4); // With a queen in the corner.
+    }
+  }
+  std::cout << "PASSED: TEST_file_formats." << std::endl;
+}
+
+void TEST_reduce() {
+  auto sorted_solutions = [](dlx::DancingLinks<dlx::ColumnWithLeastOnes> &dlx) {
+    std::vector<std::vector<int>> solns;
+    dlx.Solve(dlx::SavingVisitor{&solns});
+    for (auto &soln : solns)
+      std::sort(soln.begin(), soln.end());
+    std::sort(solns.begin(), solns.end());
+    return solns;
+  };
+  std::mt19937 gen(16);
+  std::uniform_int_distribution<int> coin(0, 3), color(0, 2);
+  for (int instance = 0; instance < 300; instance++) {
+    const int ncols = 7, sec_col = 5;
+    std::vector<std::vector<int>> rows(12), colors(12);
+    for (size_t i = 0; i < rows.size(); i++) {
+      for (int j = 0; j < ncols; j++) {
+        if (coin(gen) == 0) {
+          rows[i].push_back(j);
+          colors[i].push_back(j >= sec_col && instance % 2 ? color(gen) : 0);
+        }
+      }
+    }
+    if (instance % 3 == 0)
+      rows[11] = rows[10], colors[11] = colors[10];
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, sec_col, colors);
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> plain{mat_view}, kept{mat_view},
+        merged{mat_view};
+    if (instance % 4 == 0) // Reduce with a row selected.
+      for (auto *dlx : {&plain, &kept, &merged})
+        dlx->SelectRow(0);
+    const auto expected = sorted_solutions(plain);
+    const dlx::Reduction reduction = kept.Reduce();
+    assert(reduction.cells_after <= reduction.cells_before);
+    assert(!reduction.infeasible || expected.empty());
+    assert(sorted_solutions(kept) == expected);
+    // Merged duplicates only lose solutions with another duplicate.
+    merged.Reduce(dlx::Duplicates::MERGE);
+    const auto solns = sorted_solutions(merged);
+    assert(solns.empty() == expected.empty());
+    assert(std::includes(expected.begin(), expected.end(), solns.begin(),
+                         solns.end()));
+    kept.UnselectAllRows(); // Rows selected before Reduce() stay.
+    assert(sorted_solutions(kept) == expected);
+  }
+
+  // Row 2 lacks column 0, whose rows all have column 1, and rows 3 and
+  // 4 are equal.
+  std::vector<std::vector<int>> rows{{0, 1}, {0, 1, 2}, {1, 2}, {2}, {2}};
+  dlx::SparseMatrixFromVector mat_view(rows, 3, 3);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{mat_view};
+  dlx::Reduction reduction = dlx.Reduce(dlx::Duplicates::MERGE);
+  assert(reduction.removed_rows == 2 && reduction.removed_columns == 1);
+  assert(reduction.forced_rows == 0 && !reduction.infeasible);
+  assert(sorted_solutions(dlx) ==
+         std::vector<std::vector<int>>({{0, 3}, {1}}));
+
+  // An easy Sudoku is settled by forced rows alone.
+  const std::string puzzle = "53..7....6..195....98....6.8...6...3"
+                             "4..8.3..17...2...6.6....28....419..5....8..79";
+  SudokuMatrix matrix{3};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes, int, dlx::SearchStats> sudoku{
+      matrix};
+  int nclues = 0;
+  for (int k = 0; k < 81; k++) {
+    if (puzzle[k] != '.') {
+      assert(sudoku.SelectRow(k % 9 * 81 + k / 9 * 9 + puzzle[k] - '1'));
+      nclues++;
+    }
+  }
+  reduction = sudoku.Reduce();
+  assert(reduction.forced_rows == 81 - nclues);
+  assert(reduction.cells_after == 1 + 4 * 81); // Just the headers.
+  dlx::CountingVisitor<int> counter;
+  sudoku.Solve(counter);
+  assert(counter.Count() == 1 && sudoku.Stats().nodes == 1);
+
+  // The forced rows are saved with the arena, but not later selections.
+  rows = {{0, 1}, {1}, {2}, {2}};
+  dlx::SparseMatrixFromVector forced_view(rows, 3, 3);
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> forced{forced_view};
+  reduction = forced.Reduce();
+  assert(reduction.forced_rows == 1);
+  const std::string path = "/tmp/dlx_test_reduced_arena";
+  assert(forced.SelectRow(2) && !forced.SaveArena(path));
+  forced.UnselectRow();
+  assert(forced.SaveArena(path));
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> loaded;
+  assert(loaded.LoadArena(path));
+  std::remove(path.c_str());
+  assert(loaded.SelectedRows() == std::vector<int>({0}));
+  assert(sorted_solutions(loaded) ==
+         std::vector<std::vector<int>>({{0, 2}, {0, 3}}));
+  std::cout << "PASSED: TEST_reduce." << std::endl;
+}
+
+void TEST_propagation() {
+  using Solver = dlx::DancingLinks<dlx::ColumnWithLeastOnes, int,
+                                   dlx::SearchStats>;
+  auto sorted = [](std::vector<std::vector<int>> solns) {
+    for (auto &soln : solns)
+      std::sort(soln.begin(), soln.end());
+    std::sort(solns.begin(), solns.end());
+    return solns;
+  };
+  std::mt19937 gen(22);
+  std::uniform_int_distribution<int> coin(0, 3), color(0, 2);
+  for (int instance = 0; instance < 300; instance++) {
+    const int ncols = 8, sec_col = 6;
+    std::vector<std::vector<int>> rows(14), colors(14);
+    for (size_t i = 0; i < rows.size(); i++) {
+      for (int j = 0; j < ncols; j++) {
+        if (coin(gen) == 0) {
+          rows[i].push_back(j);
+          colors[i].push_back(j >= sec_col && instance % 2 ? color(gen) : 0);
+        }
+      }
+    }
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, sec_col, colors);
+    Solver plain{mat_view}, propagated{mat_view};
+    propagated.SetPropagation(dlx::Propagation::SINGLETONS);
+    if (instance % 4 == 0)
+      for (auto *dlx : {&plain, &propagated})
+        dlx->SelectRow(0);
+    std::vector<std::vector<int>> expected, solns, resumed;
+    plain.Solve(dlx::SavingVisitor{&expected});
+    expected = sorted(expected);
+    propagated.Solve(dlx::SavingVisitor{&solns});
+    assert(sorted(solns) == expected);
+    assert(propagated.Stats().nodes <= plain.Stats().nodes);
+    solns.clear();
+    propagated.Solve(dlx::SavingVisitor{&solns},
+                     dlx::SolutionMethod::RECURSIVE);
+    assert(sorted(solns) == expected);
+    // Resumed from a checkpoint after each solution.
+    solns.clear();
+    dlx::Checkpoint checkpoint;
+    for (bool first = true, more = true; more; first = false) {
+      auto it = first ? propagated.Solutions()
+                      : propagated.Solutions(checkpoint);
+      const std::vector<int> *soln = it.Next();
+      if ((more = soln != nullptr)) {
+        solns.push_back(*soln);
+        it.Save(&checkpoint);
+      }
+    }
+    assert(sorted(solns) == expected);
+  }
+
+  // Forced rows replace nodes, not solutions.
+  NQueensMatrix queens8{8};
+  Solver queens{queens8};
+  dlx::CountingVisitor<int> counter;
+  queens.Solve(counter);
+  const long nodes = queens.Stats().nodes;
+  queens.SetPropagation(dlx::Propagation::SINGLETONS);
+  counter = {};
+  queens.Solve(counter);
+  assert(counter.Count() == 92 && queens.Stats().forced > 0);
+  assert(queens.Stats().nodes < nodes);
+
+  // An easy Sudoku needs two nodes: the root, whose single choice
+  // forces the rest, and the solution.
+  const std::string puzzle = "53..7....6..195....98....6.8...6...3"
+                             "4..8.3..17...2...6.6....28....419..5....8..79";
+  SudokuMatrix matrix{3};
+  Solver sudoku{matrix};
+  sudoku.SetPropagation(dlx::Propagation::SINGLETONS);
+  for (int k = 0; k < 81; k++)
+    if (puzzle[k] != '.')
+      assert(sudoku.SelectRow(k % 9 * 81 + k / 9 * 9 + puzzle[k] - '1'));
+  counter = {};
+  sudoku.Solve(counter);
+  assert(counter.Count() == 1 && sudoku.Stats().nodes == 2);
+  std::cout << "PASSED: TEST_propagation." << std::endl;
+}
+
+void TEST_symmetry() {
+  // The 8 queens have 12 classes of solutions under the symmetries of
+  // the board, which all have 8 solutions but one with 4.
+  for (int n = 1; n <= 10; n++) {
+    NQueens<dlx::ColumnWithLeastOnes> nqueens{n};
+    assert(nqueens.Count() == nqueens.SymmetricCount());
+  }
+  NQueensMatrix queens{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{queens};
+  std::vector<int> rows, cols, identity(queens.Cols());
+  for (size_t j = 0; j < identity.size(); j++)
+    identity[j] = j;
+  queens.Symmetry(true, &rows, &cols);
+  assert(!dlx.AddSymmetry(rows, identity));
+  assert(dlx.AddSymmetry(rows, cols));
+  queens.Symmetry(false, &rows, &cols);
+  assert(dlx.AddSymmetry(rows, cols));
+  std::vector<std::vector<int>> classes;
+  assert(92 == dlx.SymmetricSolve(dlx::SavingVisitor{&classes}));
+  assert(12 == classes.size());
+
+  // Instances symmetric under swapping the two halves of their primary
+  // columns, and their two secondary columns: by Burnside's lemma, the
+  // number of classes is the average of the number of solutions and
+  // of those that the swap fixes.
+  std::mt19937 gen(23);
+  std::uniform_int_distribution<int> coin(0, 3);
+  for (int instance = 0; instance < 200; instance++) {
+    const int half = 3, sec_col = 2 * half, ncols = sec_col + 2;
+    std::vector<int> swap(ncols);
+    for (int j = 0; j < ncols; j++)
+      swap[j] = j < sec_col ? (j + half) % sec_col : 2 * sec_col + 1 - j;
+    auto image = [&swap](std::vector<int> row) {
+      for (int &j : row)
+        j = swap[j];
+      std::sort(row.begin(), row.end());
+      return row;
+    };
+    std::vector<std::vector<int>> rows;
+    std::vector<int> row_swap;
+    std::set<std::vector<int>> seen;
+    for (int k = 0; k < 8; k++) {
+      std::vector<int> row;
+      for (int j = 0; j < ncols; j++)
+        if (coin(gen) == 0)
+          row.push_back(j);
+      if (!seen.insert(row).second)
+        continue;
+      const int i = rows.size();
+      rows.push_back(row);
+      row_swap.push_back(i);
+      if (seen.insert(image(row)).second) {
+        rows.push_back(image(row));
+        row_swap.back() = i + 1;
+        row_swap.push_back(i);
+      }
+    }
+    dlx::SparseMatrixFromVector mat_view(rows, ncols, sec_col);
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{mat_view};
+    std::vector<std::vector<int>> solns, classes;
+    dlx.Solve(dlx::SavingVisitor{&solns});
+    long fixed = 0;
+    for (const auto &soln : solns) {
+      std::vector<int> sorted = soln, swapped;
+      std::sort(sorted.begin(), sorted.end());
+      for (int row_idx : sorted)
+        swapped.push_back(row_swap[row_idx]);
+      std::sort(swapped.begin(), swapped.end());
+      fixed += swapped == sorted;
+    }
+    assert(dlx.AddSymmetry(row_swap, swap));
+    assert(solns.size() == dlx.SymmetricSolve(dlx::SavingVisitor{&classes}));
+    assert(2 * classes.size() == solns.size() + fixed);
+    dlx.Solve(dlx::SavingVisitor{&classes}); // The instance is restored.
+    assert(classes.size() == (3 * solns.size() + fixed) / 2);
+  }
+  std::cout << "PASSED: TEST_symmetry." << std::endl;
+}
+
+void TEST_cube() {
+  auto sorted = [](std::vector<std::vector<int>> solns) {
+    for (auto &soln : solns)
+      std::sort(soln.begin(), soln.end());
+    std::sort(solns.begin(), solns.end());
+    return solns;
+  };
+  // The subtrees of the jobs hold each solution exactly once, at any
+  // depth and with propagation too.
+  std::vector<std::vector<int>> rows{{0, 3, 5}, {1, 2}, {0, 1, 2, 4}, {3, 4},
+                                     {2, 5},    {1},    {0, 5},       {3}};
+  std::vector<std::vector<int>> colors{{0, 0, 1}, {0, 0}, {0, 0, 0, 1},
+                                       {0, 2},    {0, 2}, {0},
+                                       {0, 1},    {0}};
+  dlx::SparseMatrixFromVector mat_view(rows, 6, 4, colors);
+  NQueensMatrix queens{6};
+  for (dlx::MatrixInterface *matrix :
+       std::vector<dlx::MatrixInterface *>{&mat_view, &queens}) {
+    dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{*matrix}, fresh{*matrix};
+    std::vector<std::vector<int>> expected, solns;
+    dlx.Solve(dlx::SavingVisitor{&expected});
+    for (int depth = 0; depth < 5; depth++) {
+      dlx.SetPropagation(depth % 2 ? dlx::Propagation::SINGLETONS
+                                   : dlx::Propagation::NONE);
+      solns.clear();
+      for (const dlx::CubeJob &job : dlx.Cube(depth))
+        assert(fresh.Conquer(job, dlx::SavingVisitor{&solns}));
+      assert(sorted(solns) == sorted(expected));
+    }
+  }
+
+  // Jobs solved by separate processes, through files.
+  const std::string dir = "/tmp/dlx_test_cube";
+  mkdir(dir.c_str(), 0755);
+  NQueensMatrix queens8{8};
+  dlx::DancingLinks<dlx::ColumnWithLeastOnes> dlx{queens8};
+  const std::vector<dlx::CubeJob> jobs = dlx.CubeJobs(10);
+  assert(jobs.size() >= 10);
+  std::vector<std::string> outputs;
+  for (const auto &job : jobs) {
+    const std::string path = dir + "/job-" + std::to_string(job.index);
+    assert(job.Write(path));
+    outputs.push_back(path + ".out");
+    if (fork() == 0) {
+      dlx::CubeJob read;
+      dlx::DancingLinks<dlx::ColumnWithLeastOnes> fresh{queens8};
+      dlx::CountingVisitor<int> counter;
+      if (!read.Read(path) || !fresh.Conquer(read, counter))
+        _exit(1);
+      std::ofstream out(outputs.back());
+      out << dlx::JobResultHeader(read) << counter.Count() << "\n";
+      _exit(out.flush() ? 0 : 1);
+    }
+  }
+  for (size_t k = 0; k < jobs.size(); k++) {
+    int status;
+    assert(wait(&status) > 0 && WIFEXITED(status) &&
+           WEXITSTATUS(status) == 0);
+  }
+  std::ostringstream merged;
+  std::string error;
+  assert(dlx::MergeJobResults(outputs, true, merged, &error));
+  assert(merged.str() == "92\n");
+  outputs.pop_back();
+  assert(!dlx::MergeJobResults(outputs, true, merged, &error));
+  assert(error == "job " + std::to_string(jobs.size() - 1) + " missing");
+  for (const auto &job : jobs) {
+    const std::string path = dir + "/job-" + std::to_string(job.index);
+    std::remove(path.c_str());
+    std::remove((path + ".out").c_str());
+  }
+  rmdir(dir.c_str());
+  std::cout << "PASSED: TEST_cube." << std::endl;
+}
+
+void TEST_sudoku_generator() {
+  for (int n : {2, 3}) {
+    const int width = n * n;
+    SudokuGenerator generator{n, 7}, same{n, 7}, other{n, 8};
+    Sudoku<dlx::ColumnWithLeastOnes> sudoku{n};
+    bool differ = false;
+    for (int k = 0; k < 5; k++) {
+      const std::vector<int> puzzle = generator.Next();
+      assert(puzzle == same.Next());
+      differ = differ || puzzle != other.Next();
+      // The solution is a valid grid, the only one the clues allow,
+      // and none of them can be dropped.
+      const std::vector<int> &solution = generator.Solution();
+      std::string text(width * width, '.');
+      for (size_t cell = 0; cell < text.size(); cell++) {
+        assert(puzzle[cell] == 0 || puzzle[cell] == solution[cell]);
+        if (puzzle[cell] != 0)
+          text[cell] = '0' + puzzle[cell];
+      }
+      assert(sudoku.SetProblem(text) && sudoku.Count() == 1);
+      std::ostringstream out;
+      SudokuVisitor visitor{n, SudokuFormat::ONELINE, 1, &out};
+      sudoku.Solve(visitor);
+      visitor.Flush();
+      std::string expected;
+      for (int value : solution)
+        expected += std::to_string(value);
+      assert(out.str() == expected + "\n");
+      for (size_t cell = 0; cell < text.size(); cell++) {
+        if (text[cell] != '.') {
+          std::string dropped = text;
+          dropped[cell] = '.';
+          assert(sudoku.SetProblem(dropped) && sudoku.MoreThanOneSolution());
+        }
+      }
+    }
+    assert(differ);
+  }
+  // Probes cut short keep their clues, and the puzzle unique.
+  SudokuGenerator bounded{3, 7, 1};
+  Sudoku<dlx::ColumnWithLeastOnes> sudoku{3};
+  std::string text;
+  for (int value : bounded.Next())
+    text += value == 0 ? '.' : char('0' + value);
+  assert(sudoku.SetProblem(text) && sudoku.Count() == 1);
+  std::cout << "PASSED: TEST_sudoku_generator." << std::endl;
+}
+
 int main() {
   TEST_secondary_columns();
+  TEST_sparse_matrix();
+  TEST_cell_layout();
+  TEST_select_rows();
   TEST_sudoku_2x2();
   TEST_sudoku_3x3();
+  TEST_parallel_solve();
+  TEST_batch_solver();
+  TEST_zdd();
+  TEST_bucketed_policy();
+  TEST_static_visitors();
+  TEST_search_stats();
+  TEST_colored_columns();
+  TEST_multiplicities();
+  TEST_dancing_cells();
+  TEST_bitset_engine();
+  TEST_solution_iterator();
+  TEST_checkpoint();
+  TEST_random_policy();
+  TEST_output_sinks();
+  TEST_file_formats();
+  TEST_reduce();
+  TEST_propagation();
+  TEST_symmetry();
+  TEST_cube();
+  TEST_sudoku_generator();
   return 0;
 }